@@ -0,0 +1,86 @@
+"""Times building the CFGs of functions with deeply nested if and while
+statements, like the ones in test/cfg.
+
+usage: python3 cfg_nested.py <compiler>... [-depth N] [-functions N]
+                             [-runs N] [-flag F]
+"""
+
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def nested_body(depth, indent=1):
+    pad = '    ' * indent
+    if depth == 0:
+        return f'{pad}x = x + 1.0;\n'
+
+    inner = nested_body(depth - 1, indent + 1)
+    if depth % 2:
+        return (f'{pad}if x > {depth}.0 || y {{\n'
+                f'{pad}    let a{depth}: number = x;\n'
+                f'{inner}'
+                f'{pad}}} else if x < 0.0 {{\n'
+                f'{pad}    return;\n'
+                f'{pad}}} else {{\n'
+                f'{pad}    x = x - 1.0;\n'
+                f'{pad}}}\n')
+
+    return (f'{pad}while x < {depth}.0 && !y {{\n'
+            f'{pad}    var b{depth}: number;\n'
+            f'{pad}    b{depth} = x * 2.0;\n'
+            f'{inner}'
+            f'{pad}}}\n')
+
+
+def generate(depth, functions):
+    source = ''
+    for i in range(functions):
+        source += (f'fn f{i}(p: number, y: number): void {{\n'
+                   f'    var x = p;\n'
+                   f'{nested_body(depth)}'
+                   f'}}\n\n')
+    return source + 'fn main(): void {}\n'
+
+
+def main(argv):
+    options = {'-depth': 60, '-functions': 200, '-runs': 5,
+               '-flag': '-cfg-dump'}
+    compilers = []
+    args = iter(argv)
+    for arg in args:
+        if arg in options:
+            value = next(args)
+            options[arg] = value if arg == '-flag' else int(value)
+        else:
+            compilers.append(arg)
+
+    if not compilers:
+        print(__doc__)
+        return 1
+
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, 'nested.yl')
+        with open(path, 'w') as f:
+            f.write(generate(options['-depth'], options['-functions']))
+
+        for compiler in compilers:
+            times = []
+            for _ in range(options['-runs']):
+                start = time.perf_counter()
+                subprocess.run([compiler, path, options['-flag']],
+                               stdout=subprocess.DEVNULL,
+                               stderr=subprocess.DEVNULL, check=True)
+                times.append(time.perf_counter() - start)
+
+            print(f'{compiler}: min {min(times):.3f}s '
+                  f'median {statistics.median(times):.3f}s')
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,85 @@
+"""Times the executables built from a loop that evaluates polynomials and
+divisions on every iteration, once for each set of flags.
+
+usage: python3 fp_loops.py <compiler> [-iterations N] [-runs N]
+                           [-flags F]...
+"""
+
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def generate(iterations):
+    # The bound is returned by a function with a side effect, so the loop
+    # can't be evaluated at compile time.
+    return (f'fn bound(): number {{\n'
+            f'    println({iterations});\n'
+            f'    return {iterations};\n'
+            f'}}\n\n'
+            f'fn horner(x: number): number {{\n'
+            f'    return (((x * 0.5 + 1.25) * x - 0.75) * x + 2.5) * x - 1.0;\n'
+            f'}}\n\n'
+            f'fn integrate(n: number): number {{\n'
+            f'    var sum = 0.0;\n'
+            f'    var i = 0;\n'
+            f'    while i < n {{\n'
+            f'        let x = i / n;\n'
+            f'        sum = sum + horner(x) / (1.0 + x * x);\n'
+            f'        i = i + 1;\n'
+            f'    }}\n'
+            f'    return sum;\n'
+            f'}}\n\n'
+            f'fn main(): void {{\n'
+            f'    println(integrate(bound()));\n'
+            f'}}\n')
+
+
+def main(argv):
+    options = {'-iterations': 100000000, '-runs': 5}
+    configurations = []
+    compiler = None
+    args = iter(argv)
+    for arg in args:
+        if arg in options:
+            options[arg] = int(next(args))
+        elif arg == '-flags':
+            configurations.append(next(args).split())
+        else:
+            compiler = arg
+
+    if not compiler:
+        print(__doc__)
+        return 1
+
+    if not configurations:
+        configurations = [[], ['-march=native']]
+
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, 'fp_loops.yl')
+        with open(path, 'w') as f:
+            f.write(generate(options['-iterations']))
+
+        for flags in configurations:
+            executable = os.path.join(tmp, 'fp_loops')
+            subprocess.run([compiler, path, '-o', executable] + flags,
+                           check=True, cwd=tmp)
+
+            times = []
+            for _ in range(options['-runs']):
+                start = time.perf_counter()
+                subprocess.run([executable], stdout=subprocess.DEVNULL,
+                               check=True)
+                times.append(time.perf_counter() - start)
+
+            print(f'{" ".join(flags) or "(default)"}: min {min(times):.3f}s '
+                  f'median {statistics.median(times):.3f}s')
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,80 @@
+"""Times handing a module to clang as textual IR and as bitcode: writing it
+with the compiler, then building the executable from it with clang.
+
+usage: python3 ir_handoff.py <compiler> [-functions N] [-runs N]
+"""
+
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def generate(functions):
+    # Every function loops and calls the previous one, so none of them is
+    # inlined or removed.
+    source = ''
+    for i in range(functions):
+        call = f'f{i - 1}(y) + y' if i else 'y'
+        source += (f'fn f{i}(x: number): number {{\n'
+                   f'    var y = x * {i} + 1;\n'
+                   f'    while y > 100 {{\n'
+                   f'        y = y / 2 - {i};\n'
+                   f'    }}\n'
+                   f'    return {call};\n'
+                   f'}}\n\n')
+
+    return source + (f'fn main(): void {{\n'
+                     f'    println(f{functions - 1}(3));\n'
+                     f'}}\n')
+
+
+def measure(command, runs, cwd):
+    times = []
+    for _ in range(runs):
+        start = time.perf_counter()
+        subprocess.run(command, check=True, cwd=cwd)
+        times.append(time.perf_counter() - start)
+
+    return statistics.median(times)
+
+
+def main(argv):
+    options = {'-functions': 3000, '-runs': 5}
+    compiler = None
+    args = iter(argv)
+    for arg in args:
+        if arg in options:
+            options[arg] = int(next(args))
+        else:
+            compiler = arg
+
+    if not compiler:
+        print(__doc__)
+        return 1
+
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, 'ir_handoff.yl')
+        with open(path, 'w') as f:
+            f.write(generate(options['-functions']))
+
+        for flag, extension in [('-emit-llvm', '.ll'), ('-emit-bc', '.bc')]:
+            module = os.path.join(tmp, 'ir_handoff' + extension)
+            executable = os.path.join(tmp, 'ir_handoff')
+
+            write = measure([compiler, path, flag, '-o', module],
+                            options['-runs'], tmp)
+            link = measure(['clang', module, '-o', executable],
+                           options['-runs'], tmp)
+
+            print(f'{flag}: {os.path.getsize(module)} bytes, '
+                  f'write {write:.3f}s clang {link:.3f}s '
+                  f'total {write + link:.3f}s')
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -207,20 +207,27 @@ struct VarDecl : public Decl {
   void dump(size_t level = 0) const override;
 };
 
+// The floating-point semantics a function asks for with an attribute, which
+// take precedence over the ones given on the command line.
+enum class FPMode { Default, Fast, Strict };
+
 struct FunctionDecl : public Decl {
   Type type;
   std::vector<std::unique_ptr<ParamDecl>> params;
   std::unique_ptr<Block> body;
+  FPMode fpMode;
 
   FunctionDecl(SourceLocation location,
                std::string identifier,
                Type type,
                std::vector<std::unique_ptr<ParamDecl>> params,
-               std::unique_ptr<Block> body)
+               std::unique_ptr<Block> body,
+               FPMode fpMode)
       : Decl(location, std::move(identifier)),
         type(std::move(type)),
         params(std::move(params)),
-        body(std::move(body)) {}
+        body(std::move(body)),
+        fpMode(fpMode) {}
 
   void dump(size_t level = 0) const override;
 };
@@ -354,19 +361,25 @@ struct ResolvedVarDecl : public ResolvedDecl {
 struct ResolvedFunctionDecl : public ResolvedDecl {
   std::vector<std::unique_ptr<ResolvedParamDecl>> params;
   std::unique_ptr<ResolvedBlock> body;
+  FPMode fpMode;
 
   ResolvedFunctionDecl(SourceLocation location,
                        std::string identifier,
                        Type type,
                        std::vector<std::unique_ptr<ResolvedParamDecl>> params,
-                       std::unique_ptr<ResolvedBlock> body)
+                       std::unique_ptr<ResolvedBlock> body,
+                       FPMode fpMode)
       : ResolvedDecl(location, std::move(identifier), type),
         params(std::move(params)),
-        body(std::move(body)) {}
+        body(std::move(body)),
+        fpMode(fpMode) {}
 
   void dump(size_t level = 0) const override;
 };
 
+// Whether the function is println, likely or unlikely, which Sema declares.
+bool isBuiltin(const ResolvedFunctionDecl &fn);
+
 struct ResolvedNumberLiteral : public ResolvedExpr {
   double value;
 
@@ -478,6 +491,27 @@ struct ResolvedReturnStmt : public ResolvedStmt {
 
   void dump(size_t level = 0) const override;
 };
+
+// A copy of the body of the callee in place of a call. The arguments
+// initialize the declarations that replace the parameters, and the return
+// statements of the body produce the value of the expression.
+struct ResolvedInlinedCallExpr : public ResolvedExpr {
+  const ResolvedFunctionDecl *callee;
+  std::vector<std::unique_ptr<ResolvedDeclStmt>> arguments;
+  std::unique_ptr<ResolvedBlock> body;
+
+  ResolvedInlinedCallExpr(
+      SourceLocation location,
+      const ResolvedFunctionDecl &callee,
+      std::vector<std::unique_ptr<ResolvedDeclStmt>> arguments,
+      std::unique_ptr<ResolvedBlock> body)
+      : ResolvedExpr(location, callee.type),
+        callee(&callee),
+        arguments(std::move(arguments)),
+        body(std::move(body)) {}
+
+  void dump(size_t level = 0) const override;
+};
 } // namespace yl
 
 #endif // HOW_TO_COMPILE_YOUR_LANGUAGE_AST_H
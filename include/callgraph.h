@@ -0,0 +1,74 @@
+#ifndef HOW_TO_COMPILE_YOUR_LANGUAGE_CALLGRAPH_H
+#define HOW_TO_COMPILE_YOUR_LANGUAGE_CALLGRAPH_H
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
+
+#include <memory>
+#include <vector>
+
+#include "ast.h"
+
+namespace yl {
+// The effects of calling a function, including the effects of the functions
+// it calls.
+struct FunctionEffects {
+  // Prints to the output, as println is the only function with observable
+  // side effects.
+  bool hasSideEffects = false;
+  // Can be called again before it returns.
+  bool isRecursive = false;
+  // Contains a loop or is recursive, so it's not known to terminate.
+  bool mayNotReturn = false;
+};
+
+// The call whose result is returned directly by the statement, if any.
+const ResolvedCallExpr *getTailCall(const ResolvedReturnStmt &stmt);
+
+class CallGraph {
+  std::vector<const ResolvedFunctionDecl *> functions;
+  llvm::DenseMap<const ResolvedFunctionDecl *, unsigned> indices;
+
+  std::vector<std::vector<unsigned>> callees;
+  std::vector<bool> hasLoop;
+  std::vector<bool> tailRecursive;
+
+  std::vector<std::vector<const ResolvedFunctionDecl *>> sccs;
+  std::vector<FunctionEffects> effects;
+
+  void collectCalls(unsigned caller, const ResolvedBlock &block);
+  void collectCalls(unsigned caller, const ResolvedStmt &stmt);
+  void computeSCCs();
+  void computeEffects();
+
+public:
+  explicit CallGraph(
+      const std::vector<std::unique_ptr<ResolvedFunctionDecl>> &functions);
+
+  // The functions called directly by the function.
+  std::vector<const ResolvedFunctionDecl *>
+  getCallees(const ResolvedFunctionDecl &fn) const;
+
+  // The functions that can be called transitively from the root, including
+  // the root itself, in declaration order.
+  std::vector<const ResolvedFunctionDecl *>
+  getReachableFunctions(const ResolvedFunctionDecl &root) const;
+
+  // The strongly connected components in reverse topological order, so the
+  // callees of a component come before it.
+  llvm::ArrayRef<std::vector<const ResolvedFunctionDecl *>> getSCCs() const {
+    return sccs;
+  }
+
+  const FunctionEffects &getEffects(const ResolvedFunctionDecl &fn) const {
+    return effects[indices.find(&fn)->second];
+  }
+
+  // Whether the function returns the result of calling itself anywhere.
+  bool isTailRecursive(const ResolvedFunctionDecl &fn) const {
+    return tailRecursive[indices.find(&fn)->second];
+  }
+};
+} // namespace yl
+
+#endif // HOW_TO_COMPILE_YOUR_LANGUAGE_CALLGRAPH_H
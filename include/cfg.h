@@ -1,29 +1,82 @@
 #ifndef HOW_TO_COMPILE_YOUR_LANGUAGE_CFG_H
 #define HOW_TO_COMPILE_YOUR_LANGUAGE_CFG_H
 
-#include <set>
+#include <llvm/ADT/ArrayRef.h>
+
 #include <vector>
 
 #include "ast.h"
 #include "constexpr.h"
 
 namespace yl {
-struct BasicBlock {
-  std::set<std::pair<int, bool>> predecessors;
-  std::set<std::pair<int, bool>> successors;
-  std::vector<const ResolvedStmt *> statements;
+struct CFGEdge {
+  int block : 31;
+  bool reachable : 1;
 };
 
-struct CFG {
-  std::vector<BasicBlock> basicBlocks;
+// A frozen CFG in compressed sparse row form. The edges and the statements of
+// block 'i' are stored in the [offsets[i], offsets[i + 1]) range of the
+// corresponding flat array.
+class CFG {
+  friend class CFGBuilder;
+
+  std::vector<int> predOffsets;
+  std::vector<int> succOffsets;
+  std::vector<int> stmtOffsets;
+
+  std::vector<CFGEdge> preds;
+  std::vector<CFGEdge> succs;
+  std::vector<const ResolvedStmt *> stmts;
+
+public:
   int entry = -1;
   int exit = -1;
 
-  int insertNewBlock() {
-    basicBlocks.emplace_back();
-    return basicBlocks.size() - 1;
+  int getBlockCount() const {
+    return static_cast<int>(stmtOffsets.size()) - 1;
+  }
+
+  llvm::ArrayRef<CFGEdge> getPredecessors(int block) const {
+    return llvm::makeArrayRef(preds).slice(
+        predOffsets[block], predOffsets[block + 1] - predOffsets[block]);
+  }
+
+  // The successors of a conditional block are its true and false targets in
+  // this order.
+  llvm::ArrayRef<CFGEdge> getSuccessors(int block) const {
+    return llvm::makeArrayRef(succs).slice(
+        succOffsets[block], succOffsets[block + 1] - succOffsets[block]);
+  }
+
+  // The statements of the block in the order of execution.
+  llvm::ArrayRef<const ResolvedStmt *> getStatements(int block) const {
+    return llvm::makeArrayRef(stmts).slice(
+        stmtOffsets[block], stmtOffsets[block + 1] - stmtOffsets[block]);
+  }
+
+  // Marks the 'idx'-th outgoing edge of the block unreachable.
+  void markUnreachable(int block, unsigned idx);
+
+  void dump() const;
+};
+
+class CFGBuilder {
+  struct Edge {
+    int from;
+    int to;
+    bool reachable;
   };
 
+  ConstantExpressionEvaluator *cee;
+
+  // The blocks are built bottom-up, so the statements are recorded in reverse
+  // order of execution and reversed once the CFG is built.
+  int blockCount = 0;
+  int functionExit = -1;
+  std::vector<Edge> edges;
+  std::vector<std::pair<int, const ResolvedStmt *>> statements;
+
+  int insertNewBlock() { return blockCount++; }
   int insertNewBlockBefore(int before, bool reachable) {
     int b = insertNewBlock();
     insertEdge(b, before, reachable);
@@ -31,21 +84,13 @@ struct CFG {
   }
 
   void insertEdge(int from, int to, bool reachable) {
-    basicBlocks[from].successors.emplace(std::make_pair(to, reachable));
-    basicBlocks[to].predecessors.emplace(std::make_pair(from, reachable));
+    edges.emplace_back(Edge{from, to, reachable});
   }
 
   void insertStmt(const ResolvedStmt *stmt, int block) {
-    basicBlocks[block].statements.emplace_back(stmt);
+    statements.emplace_back(block, stmt);
   }
 
-  void dump() const;
-};
-
-class CFGBuilder {
-  ConstantExpressionEvaluator cee;
-  CFG cfg;
-
   int insertBlock(const ResolvedBlock &block, int successor);
   int insertIfStmt(const ResolvedIfStmt &stmt, int exit);
   int insertWhileStmt(const ResolvedWhileStmt &stmt, int exit);
@@ -56,8 +101,18 @@ class CFGBuilder {
   int insertReturnStmt(const ResolvedReturnStmt &stmt, int block);
   int insertExpr(const ResolvedExpr &expr, int block);
 
+  CFG freeze(int entry, int exit);
+
+  // Drops the empty blocks that only forward to their successor and merges
+  // the blocks that are connected by their only reachable edge. The entry
+  // and the exit are kept and the relative order of the blocks is preserved.
+  CFG simplify(const CFG &cfg);
+
 public:
-  CFG build(const ResolvedFunctionDecl &fn);
+  explicit CFGBuilder(ConstantExpressionEvaluator &cee)
+      : cee(&cee) {}
+
+  CFG build(const ResolvedFunctionDecl &fn, bool simplified = true);
 };
 } // namespace yl
 
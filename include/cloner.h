@@ -0,0 +1,57 @@
+#ifndef HOW_TO_COMPILE_YOUR_LANGUAGE_CLONER_H
+#define HOW_TO_COMPILE_YOUR_LANGUAGE_CLONER_H
+
+#include <llvm/ADT/DenseMap.h>
+
+#include <memory>
+
+#include "ast.h"
+
+namespace yl {
+// The number of statements and expressions in the block, which is what
+// copying it costs.
+unsigned getSize(const ResolvedBlock &block);
+
+// Copies parts of the resolved tree. The references to the declarations that
+// are copied along point to the copies, the rest of them have to be mapped
+// to a replacement or a constant beforehand.
+class TreeCloner {
+  llvm::DenseMap<const ResolvedDecl *, ResolvedDecl *> replacements;
+  llvm::DenseMap<const ResolvedDecl *, double> constants;
+
+public:
+  void replace(const ResolvedDecl &decl, ResolvedDecl &replacement) {
+    replacements[&decl] = &replacement;
+  }
+  void replaceWithConstant(const ResolvedDecl &decl, double value) {
+    constants[&decl] = value;
+  }
+
+  std::unique_ptr<ResolvedBlock> clone(const ResolvedBlock &block);
+  std::unique_ptr<ResolvedStmt> clone(const ResolvedStmt &stmt);
+  std::unique_ptr<ResolvedExpr> clone(const ResolvedExpr &expr);
+  std::unique_ptr<ResolvedDeclStmt> clone(const ResolvedDeclStmt &stmt);
+};
+
+// Visits the expressions of a block that are generated, outermost first, and
+// lets the passes replace them. Folded expressions are not generated, so
+// neither they nor their operands are visited. The expression statements are
+// visited as expressions.
+class TreeWalker {
+  void walk(std::unique_ptr<ResolvedStmt> &stmt);
+
+protected:
+  // Visits the operands of the expression unless it's overridden.
+  virtual void visit(std::unique_ptr<ResolvedExpr> &expr);
+
+  void walk(std::unique_ptr<ResolvedExpr> &expr);
+  void walkOperands(ResolvedExpr &expr);
+
+public:
+  virtual ~TreeWalker() = default;
+
+  void walk(ResolvedBlock &block);
+};
+} // namespace yl
+
+#endif // HOW_TO_COMPILE_YOUR_LANGUAGE_CLONER_H
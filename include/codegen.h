@@ -1,27 +1,91 @@
 #ifndef HOW_TO_COMPILE_YOUR_LANGUAGE_CODEGEN_H
 #define HOW_TO_COMPILE_YOUR_LANGUAGE_CODEGEN_H
 
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/IR/Instructions.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/ValueHandle.h>
+#include <llvm/Target/TargetMachine.h>
 
 #include <map>
 #include <memory>
+#include <optional>
 #include <vector>
 
 #include "ast.h"
+#include "callgraph.h"
+#include "cfg.h"
+#include "constexpr.h"
+#include "ranges.h"
 
 namespace yl {
 class Codegen {
   std::vector<std::unique_ptr<ResolvedFunctionDecl>> resolvedTree;
   std::map<const ResolvedDecl *, llvm::Value *> declarations;
 
-  llvm::Value *retVal = nullptr;
   llvm::BasicBlock *retBB = nullptr;
+  // Self-recursive tail calls jump back to this block after updating the
+  // parameters.
+  llvm::BasicBlock *tailRecursionBB = nullptr;
+
+  // The return statements of an inlined body branch to its exit block, where
+  // the returned values are merged.
+  struct InlinedCall {
+    llvm::BasicBlock *exitBB;
+    std::vector<std::pair<llvm::Value *, llvm::BasicBlock *>> returns;
+  };
+  std::vector<InlinedCall> inlinedCalls;
+  // The number of loops around the statement being generated. The return
+  // statements of an inlined body don't leave the loops of the caller.
+  unsigned loopDepth = 0;
+  // The blocks of the arms that are unlikely to run, which are moved to the
+  // end of the function.
+  llvm::SmallPtrSet<llvm::BasicBlock *, 8> coldBlocks;
   llvm::Instruction *allocaInsertPoint;
+  // The return value is stored as a variable declared by the function.
+  const ResolvedFunctionDecl *currentFunction = nullptr;
+
+  // Mutable variables, parameters and the return value are either stored in
+  // stack slots or kept in SSA form by tracking their definition in every
+  // block and inserting phis on demand. The phis of a block whose
+  // predecessors are not known yet are completed once it's sealed.
+  bool ssa;
+  llvm::DenseMap<std::pair<const ResolvedDecl *, llvm::BasicBlock *>,
+                 llvm::WeakTrackingVH>
+      currentDefs;
+  llvm::DenseMap<llvm::BasicBlock *,
+                 std::vector<std::pair<const ResolvedDecl *, llvm::PHINode *>>>
+      incompletePhis;
+  llvm::SmallPtrSet<llvm::BasicBlock *, 16> sealedBlocks;
+
+  ConstantExpressionEvaluator cee;
+  CallGraph callGraph;
+  // The CFG of the current function, which the analysis of its ranges
+  // points to.
+  std::optional<CFG> cfg;
+  // The numbers of the current function that are kept in i64 values.
+  std::optional<IntegerRangeAnalysis> ranges;
+  // Generate the functions that 'main' can't reach too.
+  bool keepUnreachable;
+  // Set on every function, unless the default processor is targeted.
+  std::string targetCPU;
+  std::string targetFeatures;
+  // The flags of the floating-point operations in the functions without an
+  // attribute that overrides them.
+  llvm::FastMathFlags fastMathFlags;
 
   llvm::LLVMContext context;
   llvm::IRBuilder<> builder;
   llvm::Module module;
 
+  // The functions are spread over several modules, which refer to the ones
+  // defined in the others by their hidden external symbols.
+  bool isPartitioned = false;
+  // The generators of the other partitions, which own their modules.
+  std::vector<std::unique_ptr<Codegen>> workers;
+
   llvm::Type *generateType(Type type);
 
   llvm::Value *generateStmt(const ResolvedStmt &stmt);
@@ -30,34 +94,106 @@ class Codegen {
   llvm::Value *generateDeclStmt(const ResolvedDeclStmt &stmt);
   llvm::Value *generateAssignment(const ResolvedAssignment &stmt);
   llvm::Value *generateReturnStmt(const ResolvedReturnStmt &stmt);
+  llvm::Value *generateTailCall(const ResolvedCallExpr &call);
 
+  // Conditions and the results of logical operators are generated as i1
+  // values and exact integers as i64 values. They are only converted to
+  // doubles when they are observed.
   llvm::Value *generateExpr(const ResolvedExpr &expr);
   llvm::Value *generateCallExpr(const ResolvedCallExpr &call);
+  llvm::Value *
+  generateInlinedCallExpr(const ResolvedInlinedCallExpr &inlined);
   llvm::Value *generateBinaryOperator(const ResolvedBinaryOperator &binop);
   llvm::Value *generateUnaryOperator(const ResolvedUnaryOperator &unop);
 
+  // The value a condition is expected to have. The hints of likely() and
+  // unlikely() are passed on with llvm.expect, the ones that follow from the
+  // structure of the code are attached to the branches as weights.
+  struct BranchHint {
+    bool expected;
+    bool isExplicit;
+  };
+
   void generateConditionalOperator(const ResolvedExpr &op,
                                    llvm::BasicBlock *trueBlock,
-                                   llvm::BasicBlock *falseBlock);
+                                   llvm::BasicBlock *falseBlock,
+                                   std::optional<BranchHint> hint = {});
+  void markCold(llvm::BasicBlock *firstBlock);
 
   llvm::Value *doubleToBool(llvm::Value *v);
-  llvm::Value *boolToDouble(llvm::Value *v);
+  llvm::Value *toDouble(llvm::Value *v);
+  llvm::Value *toInteger(llvm::Value *v);
+  llvm::Type *getVariableType(const ResolvedDecl *decl);
 
   llvm::Function *getCurrentFunction();
-  llvm::AllocaInst *allocateStackVariable(const std::string_view identifier);
+  llvm::AllocaInst *allocateStackVariable(const std::string_view identifier,
+                                         llvm::Type *type);
+
+  llvm::Value *loadVariable(const ResolvedDecl *decl);
+  void storeVariable(const ResolvedDecl *decl, llvm::Value *val);
+
+  void writeVariable(const ResolvedDecl *decl,
+                     llvm::BasicBlock *block,
+                     llvm::Value *val);
+  llvm::Value *readVariable(const ResolvedDecl *decl, llvm::BasicBlock *block);
+  llvm::Value *readVariableRecursive(const ResolvedDecl *decl,
+                                     llvm::BasicBlock *block);
+  llvm::PHINode *createPhi(const ResolvedDecl *decl, llvm::BasicBlock *block);
+  llvm::Value *addPhiOperands(const ResolvedDecl *decl, llvm::PHINode *phi);
+  llvm::Value *tryRemoveTrivialPhi(llvm::PHINode *phi);
+  void sealBlock(llvm::BasicBlock *block);
 
   void generateBlock(const ResolvedBlock &block);
   void generateFunctionBody(const ResolvedFunctionDecl &functionDecl);
   void generateFunctionDecl(const ResolvedFunctionDecl &functionDecl);
 
+  void setTargetAttributes(llvm::Function &function);
+  llvm::FastMathFlags getFastMathFlags(const ResolvedFunctionDecl &function);
+
   void generateBuiltinPrintlnBody(const ResolvedFunctionDecl &println);
   void generateMainWrapper();
 
+  // Generates the bodies of the partition and declares the functions they
+  // call.
+  void
+  generateModule(llvm::ArrayRef<const ResolvedFunctionDecl *> functions,
+                 llvm::ArrayRef<const ResolvedFunctionDecl *> bodies);
+
+  // The functions 'main' can reach, or every function with keepUnreachable.
+  std::vector<const ResolvedFunctionDecl *> getGeneratedFunctions();
+  std::vector<llvm::Module *> generatePartitions(
+      llvm::ArrayRef<const ResolvedFunctionDecl *> functions,
+      llvm::ArrayRef<std::vector<const ResolvedFunctionDecl *>> bodies,
+      unsigned threadCount);
+
+  // Workers generate a partition with their own context, module and copy of
+  // the call graph.
+  explicit Codegen(const Codegen &parent);
+
 public:
   Codegen(std::vector<std::unique_ptr<ResolvedFunctionDecl>> resolvedTree,
-          std::string_view sourcePath);
-
-  llvm::Module *generateIR();
+          std::string_view sourcePath,
+          const llvm::TargetMachine &targetMachine,
+          bool ssa = true,
+          bool keepUnreachable = false,
+          llvm::FastMathFlags fastMathFlags = {});
+
+  // The number of modules a split program is generated into, at most one per
+  // function. It doesn't depend on the number of threads, so neither do the
+  // modules.
+  static constexpr unsigned splitPartitionCount = 8;
+
+  // Generates a single module, or splits the functions between the
+  // partitions in declaration order. The partitions are generated on
+  // 'threadCount' threads. Each module has its own context, so the modules
+  // can be compiled in parallel too.
+  std::vector<llvm::Module *> generateIR(bool split = false,
+                                         unsigned threadCount = 1);
+  // Generates the functions of every source file into a separate module,
+  // with the builtins in the first one.
+  std::vector<llvm::Module *>
+  generateIRPerSource(llvm::ArrayRef<std::string_view> sourcePaths,
+                      unsigned threadCount = 1);
 };
 } // namespace yl
 
@@ -1,12 +1,55 @@
 #ifndef HOW_TO_COMPILE_YOUR_LANGUAGE_CONSTEXPR_H
 #define HOW_TO_COMPILE_YOUR_LANGUAGE_CONSTEXPR_H
 
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/PointerIntPair.h>
+#include <llvm/ADT/SmallPtrSet.h>
+
+#include <cstdint>
+#include <map>
 #include <optional>
+#include <utility>
+#include <vector>
 
 #include "ast.h"
 
 namespace yl {
+// NaN is false, the same as the 'fcmp one' comparison with 0 in the
+// generated code.
+bool toBool(double value);
+
+// Applies an arithmetic or a comparison operator to constant operands.
+double applyBinaryOperator(TokenKind op, double lhs, double rhs);
+
+// The steps that the evaluators sharing it can still spend executing calls,
+// and the functions that ran out of steps, which are not executed again.
+struct CallBudget {
+  unsigned remainingSteps = 5000000;
+  llvm::SmallPtrSet<const ResolvedFunctionDecl *, 8> exhaustedFunctions;
+};
+
 class ConstantExpressionEvaluator {
+  class Interpreter;
+
+  // Calls can only be executed once the bodies of every function are
+  // resolved.
+  bool evaluateCalls;
+
+  CallBudget ownBudget;
+  CallBudget *sharedBudget = nullptr;
+
+  // The result of every expression evaluated so far, in both modes.
+  using MemoKey = llvm::PointerIntPair<const ResolvedExpr *, 1, bool>;
+  llvm::DenseMap<MemoKey, std::optional<double>> memo;
+
+  // The results of the executed calls, keyed by the callee and the bit
+  // patterns of the arguments.
+  using CallKey =
+      std::pair<const ResolvedFunctionDecl *, std::vector<uint64_t>>;
+  std::map<CallKey, std::optional<double>> callResults;
+
+  std::optional<double> evaluateUncached(const ResolvedExpr &expr,
+                                         bool allowSideEffects);
   std::optional<double>
   evaluateBinaryOperator(const ResolvedBinaryOperator &binop,
                          bool allowSideEffects);
@@ -14,8 +57,18 @@ class ConstantExpressionEvaluator {
                                               bool allowSideEffects);
   std::optional<double> evaluateDeclRefExpr(const ResolvedDeclRefExpr &dre,
                                             bool allowSideEffects);
+  std::optional<double> evaluateCallExpr(const ResolvedCallExpr &call,
+                                         bool allowSideEffects);
 
 public:
+  explicit ConstantExpressionEvaluator(bool evaluateCalls = false)
+      : evaluateCalls(evaluateCalls) {}
+
+  // Executes calls with a budget shared with other evaluators.
+  explicit ConstantExpressionEvaluator(CallBudget &budget)
+      : evaluateCalls(true),
+        sharedBudget(&budget) {}
+
   std::optional<double> evaluate(const ResolvedExpr &expr,
                                  bool allowSideEffects);
 };
@@ -0,0 +1,76 @@
+#ifndef HOW_TO_COMPILE_YOUR_LANGUAGE_DATAFLOW_H
+#define HOW_TO_COMPILE_YOUR_LANGUAGE_DATAFLOW_H
+
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/STLExtras.h>
+
+#include <cassert>
+#include <vector>
+
+#include "ast.h"
+#include "cfg.h"
+
+namespace yl {
+// Assigns a dense index to every variable declared in a CFG.
+class VariableNumbering {
+  llvm::DenseMap<const ResolvedVarDecl *, unsigned> indices;
+  std::vector<const ResolvedVarDecl *> variables;
+
+public:
+  explicit VariableNumbering(const CFG &cfg);
+
+  unsigned size() const { return variables.size(); }
+  unsigned getIndex(const ResolvedVarDecl *var) const {
+    assert(indices.count(var) && "variable is not declared in the CFG");
+    return indices.find(var)->second;
+  }
+  const ResolvedVarDecl *getVariable(unsigned idx) const {
+    return variables[idx];
+  }
+};
+
+// Returns the blocks reachable from the entry (or the exit if the CFG is
+// walked backwards) in reverse post-order, followed by the rest of the blocks.
+std::vector<int> getReversePostOrder(const CFG &cfg,
+                                     bool backward = false,
+                                     bool onlyReachableEdges = false);
+
+// Solves dataflow problems whose lattice is a fixed width bit-vector and whose
+// join is the union of the incoming states. The blocks are visited in
+// reverse post-order and only the ones whose input changed are revisited.
+class BitVectorDataflow {
+public:
+  enum class Direction { Forward, Backward };
+
+  // Turns the input state of a block into the output state in place.
+  using TransferFn = llvm::function_ref<void(int block, llvm::BitVector &)>;
+
+private:
+  const CFG *cfg;
+  Direction direction;
+  bool onlyReachableEdges;
+
+  llvm::BitVector boundary;
+  std::vector<llvm::BitVector> in;
+  std::vector<llvm::BitVector> out;
+
+public:
+  BitVectorDataflow(const CFG &cfg,
+                    Direction direction,
+                    unsigned width,
+                    bool onlyReachableEdges = false);
+
+  // Joined into the input of the entry (or the exit if solving backwards).
+  void setBoundaryState(llvm::BitVector state) { boundary = std::move(state); }
+
+  void solve(TransferFn transfer);
+
+  // The states before and after the transfer function in the direction of
+  // the analysis.
+  const llvm::BitVector &getIn(int block) const { return in[block]; }
+  const llvm::BitVector &getOut(int block) const { return out[block]; }
+};
+} // namespace yl
+
+#endif // HOW_TO_COMPILE_YOUR_LANGUAGE_DATAFLOW_H
@@ -0,0 +1,43 @@
+#ifndef HOW_TO_COMPILE_YOUR_LANGUAGE_DSE_H
+#define HOW_TO_COMPILE_YOUR_LANGUAGE_DSE_H
+
+#include <llvm/ADT/DenseSet.h>
+
+#include <memory>
+#include <vector>
+
+#include "ast.h"
+#include "callgraph.h"
+#include "cloner.h"
+
+namespace yl {
+// Removes the assignments and initializers whose value is never read by the
+// generated code. The reads that were folded into a constant are not
+// generated, so the values that are only read by them are dead too. If the
+// stored expression has side effects, it's kept as an expression statement.
+class DeadStoreElimination : private TreeWalker {
+  std::vector<std::unique_ptr<ResolvedFunctionDecl>> *resolvedTree;
+  CallGraph callGraph;
+
+  // The reads in the current function that are generated.
+  llvm::DenseSet<const ResolvedDeclRefExpr *> generatedReads;
+  llvm::DenseSet<const ResolvedStmt *> deadStores;
+
+  // Collects the generated reads.
+  void visit(std::unique_ptr<ResolvedExpr> &expr) override;
+
+  bool hasSideEffects(const ResolvedExpr &expr) const;
+
+  void removeDeadStores(ResolvedBlock &block);
+
+public:
+  explicit DeadStoreElimination(
+      std::vector<std::unique_ptr<ResolvedFunctionDecl>> &resolvedTree)
+      : resolvedTree(&resolvedTree),
+        callGraph(resolvedTree) {}
+
+  void run();
+};
+} // namespace yl
+
+#endif // HOW_TO_COMPILE_YOUR_LANGUAGE_DSE_H
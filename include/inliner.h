@@ -0,0 +1,40 @@
+#ifndef HOW_TO_COMPILE_YOUR_LANGUAGE_INLINER_H
+#define HOW_TO_COMPILE_YOUR_LANGUAGE_INLINER_H
+
+#include <llvm/ADT/DenseMap.h>
+
+#include <memory>
+#include <vector>
+
+#include "ast.h"
+#include "callgraph.h"
+#include "cloner.h"
+
+namespace yl {
+// Replaces the calls to small non-recursive functions with a copy of their
+// body. The functions are visited callees first, so the bodies that are
+// copied already have their own calls inlined.
+class Inliner : private TreeWalker {
+  // The largest body, counted in statements and expressions, that is copied
+  // into the callers.
+  static constexpr unsigned sizeThreshold = 40;
+
+  CallGraph callGraph;
+
+  llvm::DenseMap<const ResolvedFunctionDecl *, unsigned> sizes;
+
+  bool shouldInline(const ResolvedCallExpr &call) const;
+  std::unique_ptr<ResolvedExpr> inlineCall(ResolvedCallExpr &call);
+
+  void visit(std::unique_ptr<ResolvedExpr> &expr) override;
+
+public:
+  explicit Inliner(
+      std::vector<std::unique_ptr<ResolvedFunctionDecl>> &resolvedTree)
+      : callGraph(resolvedTree) {}
+
+  void run();
+};
+} // namespace yl
+
+#endif // HOW_TO_COMPILE_YOUR_LANGUAGE_INLINER_H
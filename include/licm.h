@@ -0,0 +1,55 @@
+#ifndef HOW_TO_COMPILE_YOUR_LANGUAGE_LICM_H
+#define HOW_TO_COMPILE_YOUR_LANGUAGE_LICM_H
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/SmallPtrSet.h>
+
+#include <memory>
+#include <vector>
+
+#include "ast.h"
+#include "cloner.h"
+
+namespace yl {
+// Moves the arithmetic in loops whose operands can't change while the loop
+// runs into an immutable variable declared in front of the loop. Only the
+// expressions without calls are moved, so every side effect stays in place,
+// and evaluating them when the loop doesn't run has no observable effect.
+class LoopInvariantCodeMotion : private TreeWalker {
+  // The statements of a natural loop and the variables they declare or
+  // assign. The paths that leave the body with a return are not part of the
+  // loop, so nothing is moved out of them.
+  struct LoopContents {
+    llvm::DenseSet<const ResolvedStmt *> statements;
+    llvm::SmallPtrSet<const ResolvedDecl *, 8> definitions;
+  };
+
+  std::vector<std::unique_ptr<ResolvedFunctionDecl>> *resolvedTree;
+
+  // The loops of the current function, found with the loop nest of its CFG.
+  llvm::DenseMap<const ResolvedWhileStmt *, LoopContents> loops;
+
+  // The loop whose invariants are moved and the statements they are moved
+  // into.
+  const LoopContents *currentLoop = nullptr;
+  std::vector<std::unique_ptr<ResolvedStmt>> *preheader = nullptr;
+
+  void findLoops(const ResolvedFunctionDecl &fn);
+
+  bool isInvariant(const ResolvedExpr &expr, const LoopContents &loop) const;
+
+  void visit(std::unique_ptr<ResolvedExpr> &expr) override;
+
+  void hoistInvariants(ResolvedBlock &block);
+
+public:
+  explicit LoopInvariantCodeMotion(
+      std::vector<std::unique_ptr<ResolvedFunctionDecl>> &resolvedTree)
+      : resolvedTree(&resolvedTree) {}
+
+  void run();
+};
+} // namespace yl
+
+#endif // HOW_TO_COMPILE_YOUR_LANGUAGE_LICM_H
@@ -0,0 +1,22 @@
+#ifndef HOW_TO_COMPILE_YOUR_LANGUAGE_LIVENESS_H
+#define HOW_TO_COMPILE_YOUR_LANGUAGE_LIVENESS_H
+
+#include <llvm/ADT/STLExtras.h>
+
+#include <vector>
+
+#include "ast.h"
+#include "cfg.h"
+
+namespace yl {
+// Finds the assignments and the declarations whose stored value is never
+// read, with a backward liveness analysis over the CFG. A variable is live
+// if one of its reads can be reached without going through a store to it.
+// Only the reads accepted by 'isRead' keep the variables alive. The stores
+// are returned in source order.
+std::vector<const ResolvedStmt *>
+findDeadStores(const CFG &cfg,
+               llvm::function_ref<bool(const ResolvedDeclRefExpr &)> isRead);
+} // namespace yl
+
+#endif // HOW_TO_COMPILE_YOUR_LANGUAGE_LIVENESS_H
@@ -0,0 +1,79 @@
+#ifndef HOW_TO_COMPILE_YOUR_LANGUAGE_LOOPS_H
+#define HOW_TO_COMPILE_YOUR_LANGUAGE_LOOPS_H
+
+#include <memory>
+#include <vector>
+
+#include "cfg.h"
+
+namespace yl {
+// The immediate dominators of the blocks reachable from the entry, computed
+// with the iterative algorithm of Cooper, Harvey and Kennedy. Every edge is
+// followed, even the ones that are known to be unreachable.
+class DominatorTree {
+  std::vector<int> idoms;
+  // The position of the blocks in reverse post-order.
+  std::vector<int> positions;
+
+public:
+  explicit DominatorTree(const CFG &cfg);
+
+  bool isReachable(int block) const { return idoms[block] != -1; }
+
+  // -1 for the entry and for the blocks that are not reachable.
+  int getImmediateDominator(int block) const;
+
+  // Whether every path from the entry to 'block' goes through 'dominator'.
+  bool dominates(int dominator, int block) const;
+};
+
+// A natural loop, which is the header and the blocks that can reach one of
+// the sources of its back edges without going through the header.
+struct Loop {
+  int header;
+  // The sources of the back edges.
+  std::vector<int> latches;
+  // Sorted, including the header and the blocks of the nested loops.
+  std::vector<int> blocks;
+
+  Loop *parent = nullptr;
+  std::vector<Loop *> subLoops;
+
+  explicit Loop(int header)
+      : header(header) {}
+
+  bool contains(int block) const;
+  unsigned getDepth() const;
+
+  // The blocks outside of the loop that are targets of an edge from it.
+  std::vector<int> getExits(const CFG &cfg) const;
+
+  void dump(const CFG &cfg) const;
+};
+
+// The loop nest of a CFG. The back edges are the edges whose target
+// dominates their source, and the loops that share a header are merged.
+class LoopInfo {
+  const CFG *cfg;
+
+  // The loops ordered by their headers in reverse post-order, so every loop
+  // comes after the loops that contain it.
+  std::vector<std::unique_ptr<Loop>> loops;
+  std::vector<Loop *> topLevelLoops;
+  // The innermost loop that contains each block.
+  std::vector<Loop *> innermostLoops;
+
+public:
+  LoopInfo(const CFG &cfg, const DominatorTree &domTree);
+
+  const std::vector<std::unique_ptr<Loop>> &getLoops() const { return loops; }
+  const std::vector<Loop *> &getTopLevelLoops() const {
+    return topLevelLoops;
+  }
+  Loop *getLoopFor(int block) const { return innermostLoops[block]; }
+
+  void dump() const;
+};
+} // namespace yl
+
+#endif // HOW_TO_COMPILE_YOUR_LANGUAGE_LOOPS_H
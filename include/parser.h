@@ -17,10 +17,12 @@ class Parser {
 
   void eatNextToken() { nextToken = lexer->getNextToken(); }
   void synchronize();
-  void synchronizeOn(TokenKind kind) {
+  // Skips to the attributes or the 'fn' keyword of the next function.
+  void synchronizeOnFunctionDecl() {
     incompleteAST = true;
 
-    while (nextToken.kind != kind && nextToken.kind != TokenKind::Eof)
+    while (nextToken.kind != TokenKind::KwFn &&
+           nextToken.kind != TokenKind::At && nextToken.kind != TokenKind::Eof)
       eatNextToken();
   }
 
@@ -61,7 +63,9 @@ public:
       : lexer(&lexer),
         nextToken(lexer.getNextToken()) {}
 
-  std::pair<std::vector<std::unique_ptr<FunctionDecl>>, bool> parseSourceFile();
+  // 'main' is not looked for when another source declares it.
+  std::pair<std::vector<std::unique_ptr<FunctionDecl>>, bool>
+  parseSourceFile(bool requireMain = true);
 };
 } // namespace yl
 
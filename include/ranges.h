@@ -0,0 +1,87 @@
+#ifndef HOW_TO_COMPILE_YOUR_LANGUAGE_RANGES_H
+#define HOW_TO_COMPILE_YOUR_LANGUAGE_RANGES_H
+
+#include <llvm/ADT/DenseMap.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "ast.h"
+#include "cfg.h"
+#include "dataflow.h"
+
+namespace yl {
+// Finds the numbers that only ever hold exact integers, which can be computed
+// with integer arithmetic without changing the result. A value is integral if
+// it's an integer in the [-2^53, 2^53] range, where every integer has an exact
+// double representation, and it's never -0, which has no integer counterpart.
+// The sums, differences and products of such values are exact in double
+// arithmetic too, as long as they stay in the range.
+class IntegerRangeAnalysis {
+public:
+  static constexpr int64_t maxExactInteger = int64_t(1) << 53;
+
+  struct Range {
+    enum class Kind { Undefined, Integral, Overdefined };
+
+    Kind kind = Kind::Undefined;
+    int64_t lo = 0;
+    int64_t hi = 0;
+
+    // Overdefined if the bounds are outside of the exact range.
+    static Range getIntegral(int64_t lo, int64_t hi);
+    static Range getOverdefined() { return {Kind::Overdefined, 0, 0}; }
+    static Range getValue(double value);
+
+    bool isIntegral() const { return kind == Kind::Integral; }
+
+    bool operator==(const Range &other) const;
+    bool operator!=(const Range &other) const { return !(*this == other); }
+  };
+
+private:
+  using Environment = std::vector<Range>;
+
+  // The number of descending sweeps that tighten the bounds the widening at
+  // the loop headers gave up on.
+  static constexpr unsigned narrowingSweeps = 2;
+
+  const CFG *cfg;
+  VariableNumbering variables;
+
+  std::vector<Environment> in;
+  std::vector<Environment> out;
+
+  // The ranges of the expressions and of the values stored in the variables
+  // over every execution.
+  llvm::DenseMap<const ResolvedExpr *, Range> expressions;
+  llvm::DenseMap<const ResolvedVarDecl *, Range> definitions;
+  bool record = false;
+
+  Range evaluate(const ResolvedExpr &expr, const Environment &env);
+  Range evaluateBinaryOperator(const ResolvedBinaryOperator &binop,
+                               const Environment &env);
+  Range evaluateUnaryOperator(const ResolvedUnaryOperator &unop,
+                              const Environment &env);
+
+  // Narrows the ranges of the variables compared by the condition, given
+  // which way the branch goes. Returns false if it can't go that way.
+  bool refine(const ResolvedExpr &condition, bool taken, Environment &env);
+  bool refineComparison(const ResolvedBinaryOperator &binop,
+                        bool taken,
+                        Environment &env);
+
+  void transfer(int block, Environment &env);
+
+public:
+  explicit IntegerRangeAnalysis(const CFG &cfg);
+
+  void run();
+
+  bool isIntegral(const ResolvedExpr &expr) const;
+  // Whether every value stored in the variable is integral.
+  bool isIntegral(const ResolvedDecl &decl) const;
+};
+} // namespace yl
+
+#endif // HOW_TO_COMPILE_YOUR_LANGUAGE_RANGES_H
@@ -0,0 +1,62 @@
+#ifndef HOW_TO_COMPILE_YOUR_LANGUAGE_SCCP_H
+#define HOW_TO_COMPILE_YOUR_LANGUAGE_SCCP_H
+
+#include <vector>
+
+#include "ast.h"
+#include "cfg.h"
+#include "dataflow.h"
+
+namespace yl {
+// Conditional constant propagation on the CFG of a function. Only the blocks
+// reached through executable edges are evaluated and every variable starts
+// out undefined, so a variable that is assigned the same constant on every
+// executable path is a constant, and so is a condition that depends on it.
+class ConstantPropagation {
+public:
+  struct Value {
+    enum class Kind { Undefined, Constant, Overdefined };
+
+    Kind kind = Kind::Undefined;
+    double constant = 0.0;
+
+    static Value getConstant(double constant) {
+      return {Kind::Constant, constant};
+    }
+    static Value getOverdefined() { return {Kind::Overdefined, 0.0}; }
+
+    bool isConstant() const { return kind == Kind::Constant; }
+
+    bool operator==(const Value &other) const;
+    bool operator!=(const Value &other) const { return !(*this == other); }
+  };
+
+private:
+  using Environment = std::vector<Value>;
+
+  CFG *cfg;
+  VariableNumbering variables;
+
+  std::vector<Environment> in;
+  std::vector<Environment> out;
+  std::vector<std::vector<bool>> executableEdges;
+
+  Value evaluate(const ResolvedExpr &expr,
+                 const Environment &env,
+                 bool allowSideEffects);
+  Value evaluateBinaryOperator(const ResolvedBinaryOperator &binop,
+                               const Environment &env,
+                               bool allowSideEffects);
+  void transfer(int block, Environment &env, bool fold);
+
+public:
+  explicit ConstantPropagation(CFG &cfg);
+
+  // Propagates the constants until a fixpoint is reached, stores the ones
+  // found on the expressions and marks the edges that are never executed
+  // unreachable in the CFG.
+  void run();
+};
+} // namespace yl
+
+#endif // HOW_TO_COMPILE_YOUR_LANGUAGE_SCCP_H
@@ -17,6 +17,11 @@ class Sema {
 
   ResolvedFunctionDecl *currentFunction;
 
+  // Skip the flow-sensitive checks of the functions 'main' can't reach.
+  bool checkOnlyReachable = false;
+  // Warn about the assignments and initializers whose value is never read.
+  bool warnUnusedValues = false;
+
   class ScopeRAII {
     Sema *sema;
 
@@ -61,14 +66,33 @@ class Sema {
   bool insertDeclToCurrentScope(ResolvedDecl &decl);
   std::pair<ResolvedDecl *, int> lookupDecl(const std::string id);
   std::unique_ptr<ResolvedFunctionDecl> createBuiltinPrintln();
+  std::unique_ptr<ResolvedFunctionDecl>
+  createBuiltinExpect(std::string identifier);
+
+  bool resolveFunctionBody(ResolvedFunctionDecl &fn, const Block &body);
+
+  void foldConstantCalls(ResolvedBlock &block,
+                         ConstantExpressionEvaluator &callEvaluator);
+  void foldConstantCalls(ResolvedExpr &expr,
+                         ConstantExpressionEvaluator &callEvaluator,
+                         bool isOperand = false);
 
   bool runFlowSensitiveChecks(const ResolvedFunctionDecl &fn);
   bool checkReturnOnAllPaths(const ResolvedFunctionDecl &fn, const CFG &cfg);
   bool checkVariableInitialization(const CFG &cfg);
+  void checkUnusedValues(const CFG &cfg);
+
+  // Workers resolve function bodies against a copy of the global scope.
+  explicit Sema(std::vector<ResolvedDecl *> globalScope)
+      : scopes{std::move(globalScope)} {}
 
 public:
-  explicit Sema(std::vector<std::unique_ptr<FunctionDecl>> ast)
-      : ast(std::move(ast)) {}
+  explicit Sema(std::vector<std::unique_ptr<FunctionDecl>> ast,
+                bool checkOnlyReachable = false,
+                bool warnUnusedValues = false)
+      : ast(std::move(ast)),
+        checkOnlyReachable(checkOnlyReachable),
+        warnUnusedValues(warnUnusedValues) {}
 
   std::vector<std::unique_ptr<ResolvedFunctionDecl>> resolveAST();
 };
@@ -0,0 +1,55 @@
+#ifndef HOW_TO_COMPILE_YOUR_LANGUAGE_SPECIALIZER_H
+#define HOW_TO_COMPILE_YOUR_LANGUAGE_SPECIALIZER_H
+
+#include <llvm/ADT/DenseMap.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "ast.h"
+#include "cloner.h"
+#include "constexpr.h"
+
+namespace yl {
+// Redirects the calls that pass constant arguments to a copy of the callee
+// in which the constants are substituted for the parameters. The copy is
+// folded and its dead branches are removed, and it's only kept if that made
+// it smaller than the callee.
+class Specializer : private TreeWalker {
+  // The number of statements and expressions the copies can add in total.
+  static constexpr unsigned growthBudget = 200;
+
+  std::vector<std::unique_ptr<ResolvedFunctionDecl>> *resolvedTree;
+  unsigned budget = growthBudget;
+  // Shared by the evaluators of every copy.
+  CallBudget callBudget;
+
+  // The copies made so far, keyed by the callee and the bit patterns of the
+  // constant arguments. Null if specializing the callee didn't pay off.
+  using SpecializationKey =
+      std::pair<const ResolvedFunctionDecl *,
+                std::vector<std::optional<uint64_t>>>;
+  std::map<SpecializationKey, const ResolvedFunctionDecl *> specializations;
+  llvm::DenseMap<const ResolvedFunctionDecl *, unsigned> specializationCounts;
+
+  const ResolvedFunctionDecl *getSpecialization(const ResolvedCallExpr &call);
+  std::unique_ptr<ResolvedFunctionDecl>
+  specialize(const ResolvedFunctionDecl &fn,
+             const std::vector<std::optional<uint64_t>> &args);
+
+  void visit(std::unique_ptr<ResolvedExpr> &expr) override;
+
+public:
+  explicit Specializer(
+      std::vector<std::unique_ptr<ResolvedFunctionDecl>> &resolvedTree)
+      : resolvedTree(&resolvedTree) {}
+
+  void run();
+};
+} // namespace yl
+
+#endif // HOW_TO_COMPILE_YOUR_LANGUAGE_SPECIALIZER_H
@@ -6,8 +6,13 @@
   if (!var)                                                                    \
     return nullptr;
 
+#include <algorithm>
+#include <atomic>
 #include <optional>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace yl {
 
@@ -26,6 +31,43 @@ std::nullptr_t report(SourceLocation location,
                       std::string_view message,
                       bool isWarning = false);
 
+// While alive, the diagnostics reported on the current thread are collected
+// into this buffer instead of being printed.
+class DiagnosticBuffer {
+  std::stringstream buffer;
+  std::ostream *previous;
+
+public:
+  DiagnosticBuffer();
+  ~DiagnosticBuffer();
+
+  DiagnosticBuffer(const DiagnosticBuffer &) = delete;
+  DiagnosticBuffer &operator=(const DiagnosticBuffer &) = delete;
+
+  std::string str() const { return buffer.str(); }
+};
+
+// Calls fn(thread, idx) for every idx in [0, count) on at most threadCount
+// threads, where thread identifies the thread the call happens on.
+template <typename Fn>
+void parallelFor(unsigned threadCount, size_t count, Fn fn) {
+  threadCount = std::max(1u, std::min<unsigned>(threadCount, count));
+
+  std::atomic<size_t> next = 0;
+  auto worker = [&](unsigned thread) {
+    for (size_t idx = next++; idx < count; idx = next++)
+      fn(thread, idx);
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < threadCount; ++t)
+    threads.emplace_back(worker, t);
+
+  worker(0);
+  for (auto &&t : threads)
+    t.join();
+}
+
 template <typename Ty> class ConstantValueContainer {
   std::optional<Ty> value = std::nullopt;
 
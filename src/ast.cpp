@@ -30,6 +30,15 @@ std::string_view getOpStr(TokenKind op) {
 }
 
 std::string indent(size_t level) { return std::string(level * 2, ' '); }
+
+std::string_view dumpFPMode(FPMode mode) {
+  if (mode == FPMode::Fast)
+    return " @fastmath";
+  if (mode == FPMode::Strict)
+    return " @strictfp";
+
+  return "";
+}
 } // namespace
 
 void Block::dump(size_t level) const {
@@ -117,7 +126,7 @@ void VarDecl::dump(size_t level) const {
 
 void FunctionDecl::dump(size_t level) const {
   std::cerr << indent(level) << "FunctionDecl: " << identifier << ':'
-            << type.name << '\n';
+            << type.name << dumpFPMode(fpMode) << '\n';
 
   for (auto &&param : params)
     param->dump(level + 1);
@@ -173,7 +182,7 @@ void ResolvedVarDecl::dump(size_t level) const {
 
 void ResolvedFunctionDecl::dump(size_t level) const {
   std::cerr << indent(level) << "ResolvedFunctionDecl: @(" << this << ") "
-            << identifier << ':' << '\n';
+            << identifier << ':' << dumpFPMode(fpMode) << '\n';
 
   for (auto &&param : params)
     param->dump(level + 1);
@@ -181,6 +190,10 @@ void ResolvedFunctionDecl::dump(size_t level) const {
   body->dump(level + 1);
 }
 
+bool isBuiltin(const ResolvedFunctionDecl &fn) {
+  return fn.location.filepath == "<builtin>";
+}
+
 void ResolvedNumberLiteral::dump(size_t level) const {
   std::cerr << indent(level) << "ResolvedNumberLiteral: '" << value << "'\n";
   if (auto val = getConstantValue())
@@ -250,4 +263,15 @@ void ResolvedReturnStmt::dump(size_t level) const {
   if (expr)
     expr->dump(level + 1);
 }
+
+void ResolvedInlinedCallExpr::dump(size_t level) const {
+  std::cerr << indent(level) << "ResolvedInlinedCallExpr: @(" << callee
+            << ") " << callee->identifier << '\n';
+  if (auto val = getConstantValue())
+    std::cerr << indent(level) << "| value: " << *val << '\n';
+
+  for (auto &&arg : arguments)
+    arg->dump(level + 1);
+  body->dump(level + 1);
+}
 } // namespace yl
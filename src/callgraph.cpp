@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <functional>
+
+#include "callgraph.h"
+
+namespace yl {
+const ResolvedCallExpr *getTailCall(const ResolvedReturnStmt &stmt) {
+  const ResolvedExpr *expr = stmt.expr.get();
+
+  // Folded calls are not executed.
+  while (expr && !expr->getConstantValue()) {
+    // The only builtins that return a value, likely and unlikely, return
+    // their argument.
+    if (const auto *call = dynamic_cast<const ResolvedCallExpr *>(expr)) {
+      if (!isBuiltin(*call->callee))
+        return call;
+
+      expr = call->arguments.front().get();
+      continue;
+    }
+
+    const auto *grouping = dynamic_cast<const ResolvedGroupingExpr *>(expr);
+    expr = grouping ? grouping->expr.get() : nullptr;
+  }
+
+  return nullptr;
+}
+
+CallGraph::CallGraph(
+    const std::vector<std::unique_ptr<ResolvedFunctionDecl>> &functions) {
+  for (auto &&fn : functions) {
+    indices[fn.get()] = this->functions.size();
+    this->functions.emplace_back(fn.get());
+  }
+
+  callees.resize(this->functions.size());
+  hasLoop.resize(this->functions.size());
+  tailRecursive.resize(this->functions.size());
+
+  for (unsigned i = 0; i < this->functions.size(); ++i) {
+    collectCalls(i, *this->functions[i]->body);
+
+    std::sort(callees[i].begin(), callees[i].end());
+    callees[i].erase(std::unique(callees[i].begin(), callees[i].end()),
+                     callees[i].end());
+  }
+
+  computeSCCs();
+  computeEffects();
+}
+
+void CallGraph::collectCalls(unsigned caller, const ResolvedBlock &block) {
+  for (auto &&stmt : block.statements)
+    collectCalls(caller, *stmt);
+}
+
+void CallGraph::collectCalls(unsigned caller, const ResolvedStmt &stmt) {
+  if (const auto *ifStmt = dynamic_cast<const ResolvedIfStmt *>(&stmt)) {
+    collectCalls(caller, *ifStmt->condition);
+    collectCalls(caller, *ifStmt->trueBlock);
+    if (ifStmt->falseBlock)
+      collectCalls(caller, *ifStmt->falseBlock);
+    return;
+  }
+
+  if (const auto *whileStmt = dynamic_cast<const ResolvedWhileStmt *>(&stmt)) {
+    hasLoop[caller] = true;
+    collectCalls(caller, *whileStmt->condition);
+    collectCalls(caller, *whileStmt->body);
+    return;
+  }
+
+  if (const auto *declStmt = dynamic_cast<const ResolvedDeclStmt *>(&stmt)) {
+    if (const auto &init = declStmt->varDecl->initializer)
+      collectCalls(caller, *init);
+    return;
+  }
+
+  if (const auto *assignment = dynamic_cast<const ResolvedAssignment *>(&stmt))
+    return collectCalls(caller, *assignment->expr);
+
+  if (const auto *returnStmt =
+          dynamic_cast<const ResolvedReturnStmt *>(&stmt)) {
+    if (const ResolvedCallExpr *call = getTailCall(*returnStmt);
+        call && call->callee == functions[caller])
+      tailRecursive[caller] = true;
+
+    if (returnStmt->expr)
+      collectCalls(caller, *returnStmt->expr);
+    return;
+  }
+
+  // Calls that were folded to a constant are not executed.
+  if (const auto *expr = dynamic_cast<const ResolvedExpr *>(&stmt);
+      expr && expr->getConstantValue())
+    return;
+
+  if (const auto *call = dynamic_cast<const ResolvedCallExpr *>(&stmt)) {
+    callees[caller].emplace_back(indices[call->callee]);
+    for (auto &&arg : call->arguments)
+      collectCalls(caller, *arg);
+    return;
+  }
+
+  if (const auto *inlined =
+          dynamic_cast<const ResolvedInlinedCallExpr *>(&stmt)) {
+    for (auto &&arg : inlined->arguments)
+      collectCalls(caller, *arg);
+    collectCalls(caller, *inlined->body);
+    return;
+  }
+
+  if (const auto *grouping = dynamic_cast<const ResolvedGroupingExpr *>(&stmt))
+    return collectCalls(caller, *grouping->expr);
+
+  if (const auto *binop = dynamic_cast<const ResolvedBinaryOperator *>(&stmt)) {
+    collectCalls(caller, *binop->lhs);
+    collectCalls(caller, *binop->rhs);
+    return;
+  }
+
+  if (const auto *unop = dynamic_cast<const ResolvedUnaryOperator *>(&stmt))
+    return collectCalls(caller, *unop->operand);
+}
+
+// Tarjan's algorithm, which finds the components in reverse topological
+// order.
+void CallGraph::computeSCCs() {
+  constexpr unsigned unvisited = ~0U;
+
+  std::vector<unsigned> index(functions.size(), unvisited);
+  std::vector<unsigned> lowLink(functions.size());
+  std::vector<bool> onStack(functions.size());
+  std::vector<unsigned> stack;
+  unsigned nextIndex = 0;
+
+  std::function<void(unsigned)> visit = [&](unsigned fn) {
+    index[fn] = lowLink[fn] = nextIndex++;
+    stack.emplace_back(fn);
+    onStack[fn] = true;
+
+    for (unsigned callee : callees[fn]) {
+      if (index[callee] == unvisited) {
+        visit(callee);
+        lowLink[fn] = std::min(lowLink[fn], lowLink[callee]);
+      } else if (onStack[callee]) {
+        lowLink[fn] = std::min(lowLink[fn], index[callee]);
+      }
+    }
+
+    if (lowLink[fn] != index[fn])
+      return;
+
+    std::vector<const ResolvedFunctionDecl *> &scc = sccs.emplace_back();
+    unsigned member;
+    do {
+      member = stack.back();
+      stack.pop_back();
+      onStack[member] = false;
+      scc.emplace_back(functions[member]);
+    } while (member != fn);
+  };
+
+  for (unsigned fn = 0; fn < functions.size(); ++fn)
+    if (index[fn] == unvisited)
+      visit(fn);
+}
+
+void CallGraph::computeEffects() {
+  effects.resize(functions.size());
+
+  // The callees outside of a component are already visited, while the ones
+  // inside share the effects of the component.
+  for (auto &&scc : sccs) {
+    FunctionEffects sccEffects;
+    sccEffects.isRecursive = scc.size() > 1;
+
+    for (const ResolvedFunctionDecl *fn : scc) {
+      unsigned idx = indices[fn];
+
+      sccEffects.hasSideEffects |= fn->identifier == "println";
+      sccEffects.mayNotReturn |= hasLoop[idx];
+
+      for (unsigned callee : callees[idx]) {
+        if (callee == idx)
+          sccEffects.isRecursive = true;
+
+        const FunctionEffects &calleeEffects = effects[callee];
+        sccEffects.hasSideEffects |= calleeEffects.hasSideEffects;
+        sccEffects.mayNotReturn |= calleeEffects.mayNotReturn;
+      }
+    }
+
+    sccEffects.mayNotReturn |= sccEffects.isRecursive;
+    for (const ResolvedFunctionDecl *fn : scc)
+      effects[indices[fn]] = sccEffects;
+  }
+}
+
+std::vector<const ResolvedFunctionDecl *>
+CallGraph::getCallees(const ResolvedFunctionDecl &fn) const {
+  std::vector<const ResolvedFunctionDecl *> result;
+  for (unsigned callee : callees[indices.find(&fn)->second])
+    result.emplace_back(functions[callee]);
+
+  return result;
+}
+
+std::vector<const ResolvedFunctionDecl *>
+CallGraph::getReachableFunctions(const ResolvedFunctionDecl &root) const {
+  std::vector<bool> reachable(functions.size());
+  std::vector<unsigned> worklist{indices.find(&root)->second};
+  reachable[worklist.back()] = true;
+
+  while (!worklist.empty()) {
+    unsigned fn = worklist.back();
+    worklist.pop_back();
+
+    for (unsigned callee : callees[fn]) {
+      if (reachable[callee])
+        continue;
+
+      reachable[callee] = true;
+      worklist.emplace_back(callee);
+    }
+  }
+
+  std::vector<const ResolvedFunctionDecl *> result;
+  for (unsigned fn = 0; fn < functions.size(); ++fn)
+    if (reachable[fn])
+      result.emplace_back(functions[fn]);
+
+  return result;
+}
+} // namespace yl
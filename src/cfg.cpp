@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <iostream>
+#include <set>
 
 #include "ast.h"
 #include "cfg.h"
@@ -13,7 +15,17 @@ bool isTerminator(const ResolvedStmt &stmt) {
 } // namespace
 
 void CFG::dump() const {
-  for (int i = basicBlocks.size() - 1; i >= 0; --i) {
+  auto dumpEdges = [](llvm::ArrayRef<CFGEdge> edges) {
+    std::set<std::pair<int, bool>> sorted;
+    for (auto &&edge : edges)
+      sorted.emplace(edge.block, edge.reachable);
+
+    for (auto &&[id, reachable] : sorted)
+      std::cerr << id << ((reachable) ? " " : "(U) ");
+    std::cerr << '\n';
+  };
+
+  for (int i = getBlockCount() - 1; i >= 0; --i) {
     std::cerr << '[' << i;
     if (i == entry)
       std::cerr << " (entry)";
@@ -22,57 +34,71 @@ void CFG::dump() const {
     std::cerr << ']' << '\n';
 
     std::cerr << "  preds: ";
-    for (auto &&[id, reachable] : basicBlocks[i].predecessors)
-      std::cerr << id << ((reachable) ? " " : "(U) ");
-    std::cerr << '\n';
+    dumpEdges(getPredecessors(i));
 
     std::cerr << "  succs: ";
-    for (auto &&[id, reachable] : basicBlocks[i].successors)
-      std::cerr << id << ((reachable) ? " " : "(U) ");
-    std::cerr << '\n';
+    dumpEdges(getSuccessors(i));
 
-    const auto &statements = basicBlocks[i].statements;
-    for (auto it = statements.rbegin(); it != statements.rend(); ++it)
-      (*it)->dump(1);
+    for (auto &&stmt : getStatements(i))
+      stmt->dump(1);
     std::cerr << '\n';
   }
 }
 
+void CFG::markUnreachable(int block, unsigned idx) {
+  CFGEdge &succ = succs[succOffsets[block] + idx];
+  succ.reachable = false;
+
+  // Both arms of an if statement can lead to the same block, in which case
+  // the n-th edge to the successor is the n-th edge from the block in the
+  // list of predecessors.
+  unsigned nth = 0;
+  for (unsigned i = 0; i < idx; ++i)
+    nth += succs[succOffsets[block] + i].block == succ.block;
+
+  for (int i = predOffsets[succ.block]; i < predOffsets[succ.block + 1]; ++i) {
+    if (preds[i].block == block && nth-- == 0) {
+      preds[i].reachable = false;
+      return;
+    }
+  }
+}
+
 int CFGBuilder::insertIfStmt(const ResolvedIfStmt &stmt, int exit) {
   int falseBlock = exit;
   if (stmt.falseBlock)
     falseBlock = insertBlock(*stmt.falseBlock, exit);
 
   int trueBlock = insertBlock(*stmt.trueBlock, exit);
-  int entry = cfg.insertNewBlock();
+  int entry = insertNewBlock();
 
-  std::optional<double> val = cee.evaluate(*stmt.condition, true);
-  cfg.insertEdge(entry, trueBlock, val != 0);
-  cfg.insertEdge(entry, falseBlock, val.value_or(0) == 0);
+  std::optional<double> val = cee->evaluate(*stmt.condition, true);
+  insertEdge(entry, trueBlock, !val || toBool(*val));
+  insertEdge(entry, falseBlock, !val || !toBool(*val));
 
-  cfg.insertStmt(&stmt, entry);
+  insertStmt(&stmt, entry);
   return insertExpr(*stmt.condition, entry);
 }
 
 int CFGBuilder::insertWhileStmt(const ResolvedWhileStmt &stmt, int exit) {
-  int latch = cfg.insertNewBlock();
+  int latch = insertNewBlock();
   int body = insertBlock(*stmt.body, latch);
 
-  int header = cfg.insertNewBlock();
-  cfg.insertEdge(latch, header, true);
+  int header = insertNewBlock();
+  insertEdge(latch, header, true);
 
-  std::optional<double> val = cee.evaluate(*stmt.condition, true);
-  cfg.insertEdge(header, body, val != 0);
-  cfg.insertEdge(header, exit, val.value_or(0) == 0);
+  std::optional<double> val = cee->evaluate(*stmt.condition, true);
+  insertEdge(header, body, !val || toBool(*val));
+  insertEdge(header, exit, !val || !toBool(*val));
 
-  cfg.insertStmt(&stmt, header);
+  insertStmt(&stmt, header);
   insertExpr(*stmt.condition, header);
 
   return header;
 }
 
 int CFGBuilder::insertDeclStmt(const ResolvedDeclStmt &stmt, int block) {
-  cfg.insertStmt(&stmt, block);
+  insertStmt(&stmt, block);
 
   if (const auto &init = stmt.varDecl->initializer)
     return insertExpr(*init, block);
@@ -81,14 +107,14 @@ int CFGBuilder::insertDeclStmt(const ResolvedDeclStmt &stmt, int block) {
 }
 
 int CFGBuilder::insertAssignment(const ResolvedAssignment &stmt, int block) {
-  cfg.insertStmt(&stmt, block);
+  insertStmt(&stmt, block);
   return insertExpr(*stmt.expr, block);
 }
 
 int CFGBuilder::insertReturnStmt(const ResolvedReturnStmt &stmt, int block) {
-  block = cfg.insertNewBlockBefore(cfg.exit, true);
+  block = insertNewBlockBefore(functionExit, true);
 
-  cfg.insertStmt(&stmt, block);
+  insertStmt(&stmt, block);
   if (stmt.expr)
     return insertExpr(*stmt.expr, block);
 
@@ -96,7 +122,7 @@ int CFGBuilder::insertReturnStmt(const ResolvedReturnStmt &stmt, int block) {
 }
 
 int CFGBuilder::insertExpr(const ResolvedExpr &expr, int block) {
-  cfg.insertStmt(&expr, block);
+  insertStmt(&expr, block);
 
   if (const auto *call = dynamic_cast<const ResolvedCallExpr *>(&expr)) {
     for (auto it = call->arguments.rbegin(); it != call->arguments.rend(); ++it)
@@ -144,7 +170,7 @@ int CFGBuilder::insertBlock(const ResolvedBlock &block, int succ) {
   bool insertNewBlock = true;
   for (auto it = stmts.rbegin(); it != stmts.rend(); ++it) {
     if (insertNewBlock && !isTerminator(**it))
-      succ = cfg.insertNewBlockBefore(succ, true);
+      succ = insertNewBlockBefore(succ, true);
 
     insertNewBlock = dynamic_cast<const ResolvedWhileStmt *>(it->get());
     succ = insertStmt(**it, succ);
@@ -153,13 +179,136 @@ int CFGBuilder::insertBlock(const ResolvedBlock &block, int succ) {
   return succ;
 }
 
-CFG CFGBuilder::build(const ResolvedFunctionDecl &fn) {
-  cfg = {};
-  cfg.exit = cfg.insertNewBlock();
+CFG CFGBuilder::freeze(int entry, int exit) {
+  CFG cfg;
+  cfg.entry = entry;
+  cfg.exit = exit;
+
+  // Counting sort, which keeps the relative order of the elements of a block.
+  auto sortIntoRows = [&](std::vector<int> &offsets, auto &rows, auto begin,
+                          auto end, auto getRow, auto getElement) {
+    offsets.assign(blockCount + 1, 0);
+    for (auto it = begin; it != end; ++it)
+      ++offsets[getRow(*it) + 1];
+
+    for (int i = 0; i < blockCount; ++i)
+      offsets[i + 1] += offsets[i];
+
+    std::vector<int> next(offsets.begin(), offsets.end() - 1);
+    rows.resize(offsets.back());
+    for (auto it = begin; it != end; ++it)
+      rows[next[getRow(*it)]++] = getElement(*it);
+  };
+
+  sortIntoRows(
+      cfg.succOffsets, cfg.succs, edges.begin(), edges.end(),
+      [](const Edge &e) { return e.from; },
+      [](const Edge &e) { return CFGEdge{e.to, e.reachable}; });
+
+  sortIntoRows(
+      cfg.predOffsets, cfg.preds, edges.begin(), edges.end(),
+      [](const Edge &e) { return e.to; },
+      [](const Edge &e) { return CFGEdge{e.from, e.reachable}; });
+
+  sortIntoRows(
+      cfg.stmtOffsets, cfg.stmts, statements.begin(), statements.end(),
+      [](const auto &s) { return s.first; },
+      [](const auto &s) { return s.second; });
 
-  int body = insertBlock(*fn.body, cfg.exit);
-
-  cfg.entry = cfg.insertNewBlockBefore(body, true);
   return cfg;
+}
+
+CFG CFGBuilder::simplify(const CFG &cfg) {
+  int count = cfg.getBlockCount();
+
+  auto isForwarding = [&](int bb) {
+    llvm::ArrayRef<CFGEdge> succs = cfg.getSuccessors(bb);
+    return bb != cfg.entry && bb != cfg.exit && cfg.getStatements(bb).empty() &&
+           succs.size() == 1 && succs[0].block != bb;
+  };
+
+  // Every cycle passes through the header of a loop, which is never empty, so
+  // following the forwarding blocks always terminates.
+  auto skipForwarding = [&](CFGEdge edge) {
+    while (isForwarding(edge.block)) {
+      CFGEdge next = cfg.getSuccessors(edge.block)[0];
+      edge = CFGEdge{next.block, edge.reachable && next.reachable};
+    }
+    return edge;
+  };
+
+  std::vector<Edge> forwarded;
+  std::vector<int> firstEdge(count + 1, 0);
+  std::vector<int> predCount(count, 0);
+  for (int bb = 0; bb < count; ++bb) {
+    firstEdge[bb] = forwarded.size();
+    if (isForwarding(bb))
+      continue;
+
+    for (auto &&succ : cfg.getSuccessors(bb)) {
+      CFGEdge target = skipForwarding(succ);
+      forwarded.emplace_back(Edge{bb, target.block, target.reachable});
+      ++predCount[target.block];
+    }
+  }
+  firstEdge[count] = forwarded.size();
+
+  std::vector<int> mergedSucc(count, -1);
+  std::vector<bool> isMerged(count, false);
+  for (int bb = 0; bb < count; ++bb) {
+    if (firstEdge[bb + 1] - firstEdge[bb] != 1)
+      continue;
+
+    const Edge &edge = forwarded[firstEdge[bb]];
+    if (!edge.reachable || edge.to == bb || edge.to == cfg.exit ||
+        edge.to == cfg.entry || predCount[edge.to] != 1)
+      continue;
+
+    mergedSucc[bb] = edge.to;
+    isMerged[edge.to] = true;
+  }
+
+  std::vector<int> newIds(count, -1);
+  blockCount = 0;
+  for (int bb = 0; bb < count; ++bb)
+    if (!isForwarding(bb) && !isMerged[bb])
+      newIds[bb] = blockCount++;
+
+  edges.clear();
+  statements.clear();
+  for (int bb = 0; bb < count; ++bb) {
+    if (newIds[bb] == -1)
+      continue;
+
+    int last = bb;
+    for (int merged = bb; merged != -1; merged = mergedSucc[merged]) {
+      for (auto &&stmt : cfg.getStatements(merged))
+        statements.emplace_back(newIds[bb], stmt);
+      last = merged;
+    }
+
+    for (int i = firstEdge[last]; i < firstEdge[last + 1]; ++i) {
+      const Edge &edge = forwarded[i];
+      edges.emplace_back(Edge{newIds[bb], newIds[edge.to], edge.reachable});
+    }
+  }
+
+  return freeze(newIds[cfg.entry], newIds[cfg.exit]);
+}
+
+CFG CFGBuilder::build(const ResolvedFunctionDecl &fn, bool simplified) {
+  blockCount = 0;
+  edges.clear();
+  statements.clear();
+
+  functionExit = insertNewBlock();
+  int body = insertBlock(*fn.body, functionExit);
+  int entry = insertNewBlockBefore(body, true);
+
+  // The statements were inserted in reverse order of execution.
+  std::reverse(statements.begin(), statements.end());
+  CFG cfg = freeze(entry, functionExit);
+
+  return simplified ? simplify(cfg) : cfg;
 };
 } // namespace yl
@@ -0,0 +1,258 @@
+#include <cassert>
+
+#include "cloner.h"
+
+namespace yl {
+namespace {
+// The number of statements and expressions in the statement.
+unsigned getSize(const ResolvedStmt &stmt) {
+  if (const auto *ifStmt = dynamic_cast<const ResolvedIfStmt *>(&stmt))
+    return 1 + getSize(*ifStmt->condition) + getSize(*ifStmt->trueBlock) +
+           (ifStmt->falseBlock ? getSize(*ifStmt->falseBlock) : 0);
+
+  if (const auto *whileStmt = dynamic_cast<const ResolvedWhileStmt *>(&stmt))
+    return 1 + getSize(*whileStmt->condition) + getSize(*whileStmt->body);
+
+  if (const auto *declStmt = dynamic_cast<const ResolvedDeclStmt *>(&stmt)) {
+    const auto &init = declStmt->varDecl->initializer;
+    return 1 + (init ? getSize(*init) : 0);
+  }
+
+  if (const auto *assignment = dynamic_cast<const ResolvedAssignment *>(&stmt))
+    return 1 + getSize(*assignment->expr);
+
+  if (const auto *returnStmt =
+          dynamic_cast<const ResolvedReturnStmt *>(&stmt))
+    return 1 + (returnStmt->expr ? getSize(*returnStmt->expr) : 0);
+
+  // Folded expressions are generated as a single constant.
+  if (const auto *expr = dynamic_cast<const ResolvedExpr *>(&stmt);
+      expr && expr->getConstantValue())
+    return 1;
+
+  if (const auto *call = dynamic_cast<const ResolvedCallExpr *>(&stmt)) {
+    unsigned size = 1;
+    for (auto &&arg : call->arguments)
+      size += getSize(*arg);
+    return size;
+  }
+
+  if (const auto *inlined =
+          dynamic_cast<const ResolvedInlinedCallExpr *>(&stmt)) {
+    unsigned size = getSize(*inlined->body);
+    for (auto &&arg : inlined->arguments)
+      size += getSize(*arg);
+    return size;
+  }
+
+  if (const auto *grouping = dynamic_cast<const ResolvedGroupingExpr *>(&stmt))
+    return getSize(*grouping->expr);
+
+  if (const auto *binop = dynamic_cast<const ResolvedBinaryOperator *>(&stmt))
+    return 1 + getSize(*binop->lhs) + getSize(*binop->rhs);
+
+  if (const auto *unop = dynamic_cast<const ResolvedUnaryOperator *>(&stmt))
+    return 1 + getSize(*unop->operand);
+
+  return 1;
+}
+} // namespace
+
+unsigned getSize(const ResolvedBlock &block) {
+  unsigned size = 0;
+  for (auto &&stmt : block.statements)
+    size += getSize(*stmt);
+  return size;
+}
+
+std::unique_ptr<ResolvedBlock> TreeCloner::clone(const ResolvedBlock &block) {
+  std::vector<std::unique_ptr<ResolvedStmt>> statements;
+  for (auto &&stmt : block.statements)
+    statements.emplace_back(clone(*stmt));
+
+  return std::make_unique<ResolvedBlock>(block.location,
+                                         std::move(statements));
+}
+
+std::unique_ptr<ResolvedStmt> TreeCloner::clone(const ResolvedStmt &stmt) {
+  if (const auto *expr = dynamic_cast<const ResolvedExpr *>(&stmt))
+    return clone(*expr);
+
+  if (const auto *ifStmt = dynamic_cast<const ResolvedIfStmt *>(&stmt))
+    return std::make_unique<ResolvedIfStmt>(
+        ifStmt->location, clone(*ifStmt->condition),
+        clone(*ifStmt->trueBlock),
+        ifStmt->falseBlock ? clone(*ifStmt->falseBlock) : nullptr);
+
+  if (const auto *whileStmt = dynamic_cast<const ResolvedWhileStmt *>(&stmt))
+    return std::make_unique<ResolvedWhileStmt>(whileStmt->location,
+                                               clone(*whileStmt->condition),
+                                               clone(*whileStmt->body));
+
+  if (const auto *declStmt = dynamic_cast<const ResolvedDeclStmt *>(&stmt))
+    return clone(*declStmt);
+
+  if (const auto *assignment =
+          dynamic_cast<const ResolvedAssignment *>(&stmt)) {
+    auto variable = clone(*assignment->variable);
+    return std::make_unique<ResolvedAssignment>(
+        assignment->location,
+        std::unique_ptr<ResolvedDeclRefExpr>(
+            static_cast<ResolvedDeclRefExpr *>(variable.release())),
+        clone(*assignment->expr));
+  }
+
+  if (const auto *returnStmt =
+          dynamic_cast<const ResolvedReturnStmt *>(&stmt))
+    return std::make_unique<ResolvedReturnStmt>(
+        returnStmt->location,
+        returnStmt->expr ? clone(*returnStmt->expr) : nullptr);
+
+  llvm_unreachable("unexpected statement");
+}
+
+std::unique_ptr<ResolvedDeclStmt>
+TreeCloner::clone(const ResolvedDeclStmt &stmt) {
+  const ResolvedVarDecl &varDecl = *stmt.varDecl;
+
+  auto clonedDecl = std::make_unique<ResolvedVarDecl>(
+      varDecl.location, varDecl.identifier, varDecl.type, varDecl.isMutable,
+      varDecl.initializer ? clone(*varDecl.initializer) : nullptr);
+  replacements[&varDecl] = clonedDecl.get();
+
+  return std::make_unique<ResolvedDeclStmt>(stmt.location,
+                                            std::move(clonedDecl));
+}
+
+std::unique_ptr<ResolvedExpr> TreeCloner::clone(const ResolvedExpr &expr) {
+  std::unique_ptr<ResolvedExpr> result;
+
+  if (const auto *number = dynamic_cast<const ResolvedNumberLiteral *>(&expr)) {
+    result = std::make_unique<ResolvedNumberLiteral>(number->location,
+                                                     number->value);
+  } else if (const auto *dre =
+                 dynamic_cast<const ResolvedDeclRefExpr *>(&expr)) {
+    if (auto it = constants.find(dre->decl); it != constants.end())
+      return std::make_unique<ResolvedNumberLiteral>(dre->location,
+                                                     it->second);
+
+    assert(replacements.count(dre->decl) &&
+           "reference to a declaration that is not copied");
+    result = std::make_unique<ResolvedDeclRefExpr>(
+        dre->location, *replacements[dre->decl]);
+  } else if (const auto *call = dynamic_cast<const ResolvedCallExpr *>(&expr)) {
+    std::vector<std::unique_ptr<ResolvedExpr>> arguments;
+    for (auto &&arg : call->arguments)
+      arguments.emplace_back(clone(*arg));
+
+    result = std::make_unique<ResolvedCallExpr>(call->location, *call->callee,
+                                                std::move(arguments));
+  } else if (const auto *inlined =
+                 dynamic_cast<const ResolvedInlinedCallExpr *>(&expr)) {
+    std::vector<std::unique_ptr<ResolvedDeclStmt>> arguments;
+    for (auto &&arg : inlined->arguments)
+      arguments.emplace_back(clone(*arg));
+
+    result = std::make_unique<ResolvedInlinedCallExpr>(
+        inlined->location, *inlined->callee, std::move(arguments),
+        clone(*inlined->body));
+  } else if (const auto *grouping =
+                 dynamic_cast<const ResolvedGroupingExpr *>(&expr)) {
+    result = std::make_unique<ResolvedGroupingExpr>(grouping->location,
+                                                    clone(*grouping->expr));
+  } else if (const auto *binop =
+                 dynamic_cast<const ResolvedBinaryOperator *>(&expr)) {
+    result = std::make_unique<ResolvedBinaryOperator>(
+        binop->location, binop->op, clone(*binop->lhs), clone(*binop->rhs));
+  } else if (const auto *unop =
+                 dynamic_cast<const ResolvedUnaryOperator *>(&expr)) {
+    result = std::make_unique<ResolvedUnaryOperator>(
+        unop->location, unop->op, clone(*unop->operand));
+  } else {
+    llvm_unreachable("unexpected expression");
+  }
+
+  result->setConstantValue(expr.getConstantValue());
+  return result;
+}
+
+void TreeWalker::walk(ResolvedBlock &block) {
+  for (auto &&stmt : block.statements)
+    walk(stmt);
+}
+
+void TreeWalker::walk(std::unique_ptr<ResolvedStmt> &stmt) {
+  if (auto *ifStmt = dynamic_cast<ResolvedIfStmt *>(stmt.get())) {
+    walk(ifStmt->condition);
+    walk(*ifStmt->trueBlock);
+    if (ifStmt->falseBlock)
+      walk(*ifStmt->falseBlock);
+    return;
+  }
+
+  if (auto *whileStmt = dynamic_cast<ResolvedWhileStmt *>(stmt.get())) {
+    walk(whileStmt->condition);
+    walk(*whileStmt->body);
+    return;
+  }
+
+  if (auto *declStmt = dynamic_cast<ResolvedDeclStmt *>(stmt.get())) {
+    if (declStmt->varDecl->initializer)
+      walk(declStmt->varDecl->initializer);
+    return;
+  }
+
+  if (auto *assignment = dynamic_cast<ResolvedAssignment *>(stmt.get()))
+    return walk(assignment->expr);
+
+  if (auto *returnStmt = dynamic_cast<ResolvedReturnStmt *>(stmt.get())) {
+    if (returnStmt->expr)
+      walk(returnStmt->expr);
+    return;
+  }
+
+  // An expression statement, which is replaced as an expression.
+  if (dynamic_cast<ResolvedExpr *>(stmt.get())) {
+    std::unique_ptr<ResolvedExpr> expr(
+        static_cast<ResolvedExpr *>(stmt.release()));
+    walk(expr);
+    stmt = std::move(expr);
+  }
+}
+
+void TreeWalker::walk(std::unique_ptr<ResolvedExpr> &expr) {
+  if (!expr->getConstantValue())
+    visit(expr);
+}
+
+void TreeWalker::visit(std::unique_ptr<ResolvedExpr> &expr) {
+  walkOperands(*expr);
+}
+
+void TreeWalker::walkOperands(ResolvedExpr &expr) {
+  if (auto *call = dynamic_cast<ResolvedCallExpr *>(&expr)) {
+    for (auto &&arg : call->arguments)
+      walk(arg);
+    return;
+  }
+
+  if (auto *inlined = dynamic_cast<ResolvedInlinedCallExpr *>(&expr)) {
+    for (auto &&arg : inlined->arguments)
+      walk(arg->varDecl->initializer);
+    walk(*inlined->body);
+    return;
+  }
+
+  if (auto *grouping = dynamic_cast<ResolvedGroupingExpr *>(&expr))
+    return walk(grouping->expr);
+
+  if (auto *binop = dynamic_cast<ResolvedBinaryOperator *>(&expr)) {
+    walk(binop->lhs);
+    walk(binop->rhs);
+    return;
+  }
+
+  if (auto *unop = dynamic_cast<ResolvedUnaryOperator *>(&expr))
+    return walk(unop->operand);
+}
+} // namespace yl
@@ -1,18 +1,95 @@
+#include <algorithm>
+
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/IR/CFG.h>
 #include <llvm/IR/Function.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Module.h>
-#include <llvm/Support/Host.h>
 
+#include "cfg.h"
 #include "codegen.h"
+#include "utils.h"
 
 namespace yl {
+namespace {
+// The weights llvm.expect is lowered to.
+constexpr uint32_t likelyWeight = 2000;
+constexpr uint32_t unlikelyWeight = 1;
+
+bool isBuiltinExpect(const ResolvedFunctionDecl &fn) {
+  return fn.identifier == "likely" || fn.identifier == "unlikely";
+}
+
+// The value likely() or unlikely() says the whole condition has.
+std::optional<bool> getExpectedValue(const ResolvedExpr &cond) {
+  if (const auto *grouping = dynamic_cast<const ResolvedGroupingExpr *>(&cond))
+    return getExpectedValue(*grouping->expr);
+
+  const auto *unop = dynamic_cast<const ResolvedUnaryOperator *>(&cond);
+  if (unop && unop->op == TokenKind::Excl) {
+    if (std::optional<bool> expected = getExpectedValue(*unop->operand))
+      return !*expected;
+    return std::nullopt;
+  }
+
+  if (const auto *call = dynamic_cast<const ResolvedCallExpr *>(&cond))
+    if (isBuiltinExpect(*call->callee))
+      return call->callee->identifier == "likely";
+
+  return std::nullopt;
+}
+
+bool endsWithReturn(const ResolvedBlock &block) {
+  return !block.statements.empty() &&
+         dynamic_cast<const ResolvedReturnStmt *>(
+             block.statements.back().get());
+}
+
+void setBranchWeights(llvm::BranchInst *br, bool expected) {
+  llvm::MDBuilder mdBuilder(br->getContext());
+  br->setMetadata(llvm::LLVMContext::MD_prof,
+                  expected ? mdBuilder.createBranchWeights(likelyWeight,
+                                                           unlikelyWeight)
+                           : mdBuilder.createBranchWeights(unlikelyWeight,
+                                                           likelyWeight));
+}
+} // namespace
+
 Codegen::Codegen(
     std::vector<std::unique_ptr<ResolvedFunctionDecl>> resolvedTree,
-    std::string_view sourcePath)
+    std::string_view sourcePath,
+    const llvm::TargetMachine &targetMachine,
+    bool ssa,
+    bool keepUnreachable,
+    llvm::FastMathFlags fastMathFlags)
     : resolvedTree(std::move(resolvedTree)),
+      ssa(ssa),
+      callGraph(this->resolvedTree),
+      keepUnreachable(keepUnreachable),
+      targetCPU(targetMachine.getTargetCPU()),
+      targetFeatures(targetMachine.getTargetFeatureString()),
+      fastMathFlags(fastMathFlags),
       builder(context),
       module("<translation_unit>", context) {
   module.setSourceFileName(sourcePath);
-  module.setTargetTriple(llvm::sys::getDefaultTargetTriple());
+  module.setTargetTriple(targetMachine.getTargetTriple().str());
+  module.setDataLayout(targetMachine.createDataLayout());
+}
+
+Codegen::Codegen(const Codegen &parent)
+    : ssa(parent.ssa),
+      callGraph(parent.callGraph),
+      keepUnreachable(parent.keepUnreachable),
+      targetCPU(parent.targetCPU),
+      targetFeatures(parent.targetFeatures),
+      fastMathFlags(parent.fastMathFlags),
+      builder(context),
+      module(parent.module.getModuleIdentifier(), context),
+      isPartitioned(parent.isPartitioned) {
+  module.setSourceFileName(parent.module.getSourceFileName());
+  module.setTargetTriple(parent.module.getTargetTriple());
+  module.setDataLayout(parent.module.getDataLayout());
 }
 
 llvm::Type *Codegen::generateType(Type type) {
@@ -45,6 +122,20 @@ llvm::Value *Codegen::generateStmt(const ResolvedStmt &stmt) {
 }
 
 llvm::Value *Codegen::generateIfStmt(const ResolvedIfStmt &stmt) {
+  // If the condition is known, the same arms are unreachable as in the CFG,
+  // so only the other one is generated. The condition is still evaluated for
+  // its side effects.
+  if (std::optional<double> val = cee.evaluate(*stmt.condition, true)) {
+    generateExpr(*stmt.condition);
+
+    if (toBool(*val))
+      generateBlock(*stmt.trueBlock);
+    else if (stmt.falseBlock)
+      generateBlock(*stmt.falseBlock);
+
+    return nullptr;
+  }
+
   llvm::Function *function = getCurrentFunction();
 
   auto *trueBB = llvm::BasicBlock::Create(context, "if.true");
@@ -54,43 +145,94 @@ llvm::Value *Codegen::generateIfStmt(const ResolvedIfStmt &stmt) {
   if (stmt.falseBlock)
     elseBB = llvm::BasicBlock::Create(context, "if.false");
 
-  llvm::Value *cond = generateExpr(*stmt.condition);
-  builder.CreateCondBr(doubleToBool(cond), trueBB, elseBB);
+  // Without a hint in the source, a return from a loop is expected not to be
+  // taken, as it leaves the loop at most once, while the loop can iterate
+  // many times.
+  std::optional<bool> expected = getExpectedValue(*stmt.condition);
+  std::optional<BranchHint> hint;
+  if (!expected && !stmt.falseBlock && loopDepth &&
+      endsWithReturn(*stmt.trueBlock)) {
+    expected = false;
+    hint = BranchHint{false, /*isExplicit=*/false};
+  }
+
+  generateConditionalOperator(*stmt.condition, trueBB, elseBB, hint);
 
   trueBB->insertInto(function);
+  sealBlock(trueBB);
   builder.SetInsertPoint(trueBB);
   generateBlock(*stmt.trueBlock);
   builder.CreateBr(exitBB);
+  if (expected == false)
+    markCold(trueBB);
 
   if (stmt.falseBlock) {
     elseBB->insertInto(function);
+    sealBlock(elseBB);
 
     builder.SetInsertPoint(elseBB);
     generateBlock(*stmt.falseBlock);
     builder.CreateBr(exitBB);
+    if (expected == true)
+      markCold(elseBB);
   }
 
   exitBB->insertInto(function);
+  sealBlock(exitBB);
   builder.SetInsertPoint(exitBB);
   return nullptr;
 }
 
 llvm::Value *Codegen::generateWhileStmt(const ResolvedWhileStmt &stmt) {
+  std::optional<double> val = cee.evaluate(*stmt.condition, true);
+
+  // A loop that is never entered only evaluates its condition once.
+  if (val && !toBool(*val)) {
+    generateExpr(*stmt.condition);
+    return nullptr;
+  }
+
   llvm::Function *function = getCurrentFunction();
 
+  // A loop that is never exited jumps back to its condition unconditionally
+  // and the code after it is unreachable.
+  if (val) {
+    auto *body = llvm::BasicBlock::Create(context, "while.body", function);
+    builder.CreateBr(body);
+
+    builder.SetInsertPoint(body);
+    generateExpr(*stmt.condition);
+    ++loopDepth;
+    generateBlock(*stmt.body);
+    --loopDepth;
+
+    if (builder.GetInsertBlock())
+      builder.CreateBr(body);
+
+    sealBlock(body);
+    builder.ClearInsertionPoint();
+    return nullptr;
+  }
+
   auto *header = llvm::BasicBlock::Create(context, "while.cond", function);
   auto *body = llvm::BasicBlock::Create(context, "while.body", function);
   auto *exit = llvm::BasicBlock::Create(context, "while.exit", function);
 
   builder.CreateBr(header);
 
+  // The back edge is expected to be taken.
   builder.SetInsertPoint(header);
-  llvm::Value *cond = generateExpr(*stmt.condition);
-  builder.CreateCondBr(doubleToBool(cond), body, exit);
+  generateConditionalOperator(*stmt.condition, body, exit,
+                              BranchHint{true, /*isExplicit=*/false});
+  sealBlock(body);
+  sealBlock(exit);
 
   builder.SetInsertPoint(body);
+  ++loopDepth;
   generateBlock(*stmt.body);
+  --loopDepth;
   builder.CreateBr(header);
+  sealBlock(header);
 
   builder.SetInsertPoint(exit);
   return nullptr;
@@ -98,28 +240,82 @@ llvm::Value *Codegen::generateWhileStmt(const ResolvedWhileStmt &stmt) {
 
 llvm::Value *Codegen::generateDeclStmt(const ResolvedDeclStmt &stmt) {
   const auto *decl = stmt.varDecl.get();
-  llvm::AllocaInst *var = allocateStackVariable(decl->identifier);
 
-  if (const auto &init = decl->initializer)
-    builder.CreateStore(generateExpr(*init), var);
+  if (ssa) {
+    const auto &init = decl->initializer;
+    if (!init)
+      return nullptr;
 
+    // An initialized constant never changes, so it's bound to its value.
+    llvm::Value *val = generateExpr(*init);
+    if (decl->isMutable)
+      storeVariable(decl, val);
+    else
+      declarations[decl] = val;
+
+    return nullptr;
+  }
+
+  llvm::AllocaInst *var =
+      allocateStackVariable(decl->identifier, getVariableType(decl));
   declarations[decl] = var;
+
+  if (const auto &init = decl->initializer)
+    storeVariable(decl, generateExpr(*init));
+
   return nullptr;
 }
 
 llvm::Value *Codegen::generateAssignment(const ResolvedAssignment &stmt) {
-  return builder.CreateStore(generateExpr(*stmt.expr),
-                             declarations[stmt.variable->decl]);
+  llvm::Value *val = generateExpr(*stmt.expr);
+  storeVariable(stmt.variable->decl, val);
+  return val;
 }
 
 llvm::Value *Codegen::generateReturnStmt(const ResolvedReturnStmt &stmt) {
+  if (!inlinedCalls.empty()) {
+    if (stmt.expr) {
+      llvm::Value *val = toDouble(generateExpr(*stmt.expr));
+      inlinedCalls.back().returns.emplace_back(val, builder.GetInsertBlock());
+    }
+
+    return builder.CreateBr(inlinedCalls.back().exitBB);
+  }
+
+  if (const ResolvedCallExpr *call = getTailCall(stmt))
+    return generateTailCall(*call);
+
   if (stmt.expr)
-    builder.CreateStore(generateExpr(*stmt.expr), retVal);
+    storeVariable(currentFunction, generateExpr(*stmt.expr));
 
   assert(retBB && "function with return stmt doesn't have a return block");
   return builder.CreateBr(retBB);
 }
 
+llvm::Value *Codegen::generateTailCall(const ResolvedCallExpr &call) {
+  if (call.callee == currentFunction) {
+    // Every argument is evaluated before the parameters are overwritten.
+    std::vector<llvm::Value *> args;
+    for (auto &&arg : call.arguments)
+      args.emplace_back(toDouble(generateExpr(*arg)));
+
+    for (size_t i = 0; i < args.size(); ++i)
+      storeVariable(currentFunction->params[i].get(), args[i]);
+
+    return builder.CreateBr(tailRecursionBB);
+  }
+
+  // A guaranteed tail call requires the prototypes of the caller and the
+  // callee to match, otherwise it's only a hint.
+  auto *callInst = llvm::cast<llvm::CallInst>(generateCallExpr(call));
+  callInst->setTailCallKind(call.callee->params.size() ==
+                                    currentFunction->params.size()
+                                ? llvm::CallInst::TCK_MustTail
+                                : llvm::CallInst::TCK_Tail);
+
+  return builder.CreateRet(callInst);
+}
+
 llvm::Value *Codegen::generateExpr(const ResolvedExpr &expr) {
   if (auto *number = dynamic_cast<const ResolvedNumberLiteral *>(&expr))
     return llvm::ConstantFP::get(builder.getDoubleTy(), number->value);
@@ -128,11 +324,14 @@ llvm::Value *Codegen::generateExpr(const ResolvedExpr &expr) {
     return llvm::ConstantFP::get(builder.getDoubleTy(), *val);
 
   if (auto *dre = dynamic_cast<const ResolvedDeclRefExpr *>(&expr))
-    return builder.CreateLoad(builder.getDoubleTy(), declarations[dre->decl]);
+    return loadVariable(dre->decl);
 
   if (auto *call = dynamic_cast<const ResolvedCallExpr *>(&expr))
     return generateCallExpr(*call);
 
+  if (auto *inlined = dynamic_cast<const ResolvedInlinedCallExpr *>(&expr))
+    return generateInlinedCallExpr(*inlined);
+
   if (auto *grouping = dynamic_cast<const ResolvedGroupingExpr *>(&expr))
     return generateExpr(*grouping->expr);
 
@@ -146,57 +345,197 @@ llvm::Value *Codegen::generateExpr(const ResolvedExpr &expr) {
 }
 
 llvm::Value *Codegen::generateCallExpr(const ResolvedCallExpr &call) {
+  // The hint is lost when the value is not branched on.
+  if (isBuiltinExpect(*call.callee))
+    return toDouble(generateExpr(*call.arguments.front()));
+
   llvm::Function *callee = module.getFunction(call.callee->identifier);
 
   std::vector<llvm::Value *> args;
   for (auto &&arg : call.arguments)
-    args.emplace_back(generateExpr(*arg));
+    args.emplace_back(toDouble(generateExpr(*arg)));
+
+  // The flags of the caller don't apply to the value the callee returns.
+  llvm::IRBuilderBase::FastMathFlagGuard callerFlags(builder);
+  builder.clearFastMathFlags();
+  llvm::CallInst *callInst = builder.CreateCall(callee, args);
+
+  const FunctionEffects &effects = callGraph.getEffects(*call.callee);
+  callInst->setDoesNotThrow();
+  if (!effects.hasSideEffects)
+    callInst->setDoesNotAccessMemory();
+  if (!effects.mayNotReturn)
+    callInst->addFnAttr(llvm::Attribute::WillReturn);
+
+  return callInst;
+}
+
+llvm::Value *
+Codegen::generateInlinedCallExpr(const ResolvedInlinedCallExpr &inlined) {
+  llvm::Function *function = getCurrentFunction();
+
+  for (auto &&arg : inlined.arguments)
+    generateDeclStmt(*arg);
+
+  inlinedCalls.emplace_back(InlinedCall{
+      llvm::BasicBlock::Create(context, "inline.exit"), {}});
+  {
+    // The operations of the body keep the semantics of the callee.
+    llvm::IRBuilderBase::FastMathFlagGuard callerFlags(builder);
+    builder.setFastMathFlags(getFastMathFlags(*inlined.callee));
+
+    unsigned callerLoopDepth = std::exchange(loopDepth, 0);
+    generateBlock(*inlined.body);
+    loopDepth = callerLoopDepth;
+  }
+
+  // Only a void callee can leave its body at the end, unless the path is
+  // known to be dead, but not by the generator.
+  bool isVoid = inlined.type.kind == Type::Kind::Void;
+  if (llvm::BasicBlock *block = builder.GetInsertBlock()) {
+    if (!isVoid)
+      inlinedCalls.back().returns.emplace_back(
+          llvm::UndefValue::get(builder.getDoubleTy()), block);
+    builder.CreateBr(inlinedCalls.back().exitBB);
+  }
+
+  InlinedCall call = std::move(inlinedCalls.back());
+  inlinedCalls.pop_back();
+
+  if (llvm::BasicBlock *pred = call.exitBB->getSinglePredecessor()) {
+    // A body with a single exit continues in the block that leaves it.
+    pred->getTerminator()->eraseFromParent();
+    delete call.exitBB;
+    builder.SetInsertPoint(pred);
+  } else {
+    // If the body never completes, the rest of the expression is generated
+    // into the unreachable exit block.
+    call.exitBB->insertInto(function);
+    sealBlock(call.exitBB);
+    builder.SetInsertPoint(call.exitBB);
+  }
+
+  if (isVoid)
+    return nullptr;
 
-  return builder.CreateCall(callee, args);
+  if (call.returns.empty())
+    return llvm::UndefValue::get(builder.getDoubleTy());
+
+  if (call.returns.size() == 1)
+    return call.returns.front().first;
+
+  llvm::PHINode *phi = builder.CreatePHI(builder.getDoubleTy(),
+                                         call.returns.size(), "inline.result");
+  for (auto &&[val, block] : call.returns)
+    phi->addIncoming(val, block);
+
+  return phi;
 }
 
 llvm::Value *Codegen::generateUnaryOperator(const ResolvedUnaryOperator &unop) {
   llvm::Value *rhs = generateExpr(*unop.operand);
 
   if (unop.op == TokenKind::Excl)
-    return boolToDouble(builder.CreateNot(doubleToBool(rhs)));
+    return builder.CreateNot(doubleToBool(rhs));
+
+  if (unop.op == TokenKind::Minus && ranges->isIntegral(unop))
+    return builder.CreateNSWNeg(toInteger(rhs));
 
   if (unop.op == TokenKind::Minus)
-    return builder.CreateFNeg(rhs);
+    return builder.CreateFNeg(toDouble(rhs));
 
   llvm_unreachable("unknown unary op");
 }
 
 void Codegen::generateConditionalOperator(const ResolvedExpr &op,
                                           llvm::BasicBlock *trueBB,
-                                          llvm::BasicBlock *falseBB) {
+                                          llvm::BasicBlock *falseBB,
+                                          std::optional<BranchHint> hint) {
   llvm::Function *function = getCurrentFunction();
+
+  // The branches on a known condition always go the same way.
+  if (std::optional<double> val = cee.evaluate(op, true))
+    hint = BranchHint{toBool(*val), /*isExplicit=*/false};
+
+  if (std::optional<double> val = op.getConstantValue()) {
+    llvm::BranchInst *br = builder.CreateCondBr(
+        doubleToBool(generateExpr(op)), trueBB, falseBB);
+    setBranchWeights(br, toBool(*val));
+    return;
+  }
+
+  // Groupings and negations are turned into branches instead of values too.
+  if (const auto *grouping = dynamic_cast<const ResolvedGroupingExpr *>(&op))
+    return generateConditionalOperator(*grouping->expr, trueBB, falseBB,
+                                       hint);
+
+  const auto *unop = dynamic_cast<const ResolvedUnaryOperator *>(&op);
+  if (unop && unop->op == TokenKind::Excl) {
+    if (hint)
+      hint->expected = !hint->expected;
+    return generateConditionalOperator(*unop->operand, falseBB, trueBB, hint);
+  }
+
+  // The hints in the source replace the ones that come from the structure.
+  const auto *call = dynamic_cast<const ResolvedCallExpr *>(&op);
+  if (call && isBuiltinExpect(*call->callee))
+    return generateConditionalOperator(
+        *call->arguments.front(), trueBB, falseBB,
+        BranchHint{call->callee->identifier == "likely",
+                   /*isExplicit=*/true});
+
+  // If a disjunction is expected to be false, both of its operands are, and
+  // if it's expected to be true, the right operand is when it's evaluated.
+  // The same holds for conjunctions the other way around.
   const auto *binop = dynamic_cast<const ResolvedBinaryOperator *>(&op);
 
   if (binop && binop->op == TokenKind::PipePipe) {
+    std::optional<BranchHint> lhsHint;
+    if (hint && !hint->expected)
+      lhsHint = hint;
+
     llvm::BasicBlock *nextBB =
         llvm::BasicBlock::Create(context, "or.lhs.false", function);
-    generateConditionalOperator(*binop->lhs, trueBB, nextBB);
+    generateConditionalOperator(*binop->lhs, trueBB, nextBB, lhsHint);
+    sealBlock(nextBB);
 
     builder.SetInsertPoint(nextBB);
-    generateConditionalOperator(*binop->rhs, trueBB, falseBB);
+    generateConditionalOperator(*binop->rhs, trueBB, falseBB, hint);
     return;
   }
 
   if (binop && binop->op == TokenKind::AmpAmp) {
+    std::optional<BranchHint> lhsHint;
+    if (hint && hint->expected)
+      lhsHint = hint;
+
     llvm::BasicBlock *nextBB =
         llvm::BasicBlock::Create(context, "and.lhs.true", function);
-    generateConditionalOperator(*binop->lhs, nextBB, falseBB);
+    generateConditionalOperator(*binop->lhs, nextBB, falseBB, lhsHint);
+    sealBlock(nextBB);
 
     builder.SetInsertPoint(nextBB);
-    generateConditionalOperator(*binop->rhs, trueBB, falseBB);
+    generateConditionalOperator(*binop->rhs, trueBB, falseBB, hint);
     return;
   }
 
   llvm::Value *val = doubleToBool(generateExpr(op));
-  builder.CreateCondBr(val, trueBB, falseBB);
+  if (hint && hint->isExplicit)
+    val = builder.CreateIntrinsic(llvm::Intrinsic::expect, {val->getType()},
+                                  {val, builder.getInt1(hint->expected)});
+
+  llvm::BranchInst *br = builder.CreateCondBr(val, trueBB, falseBB);
+  if (hint && !hint->isExplicit)
+    setBranchWeights(br, hint->expected);
 };
 
+void Codegen::markCold(llvm::BasicBlock *firstBlock) {
+  // The blocks of an arm are the ones that were added since its first one.
+  llvm::Function *function = firstBlock->getParent();
+  for (auto it = firstBlock->getIterator(); it != function->end(); ++it)
+    coldBlocks.insert(&*it);
+}
+
 llvm::Value *
 Codegen::generateBinaryOperator(const ResolvedBinaryOperator &binop) {
   TokenKind op = binop.op;
@@ -214,12 +553,14 @@ Codegen::generateBinaryOperator(const ResolvedBinaryOperator &binop) {
     llvm::BasicBlock *trueBB = isOr ? mergeBB : rhsBB;
     llvm::BasicBlock *falseBB = isOr ? rhsBB : mergeBB;
     generateConditionalOperator(*binop.lhs, trueBB, falseBB);
+    sealBlock(rhsBB);
 
     builder.SetInsertPoint(rhsBB);
     llvm::Value *rhs = doubleToBool(generateExpr(*binop.rhs));
     builder.CreateBr(mergeBB);
 
     rhsBB = builder.GetInsertBlock();
+    sealBlock(mergeBB);
     builder.SetInsertPoint(mergeBB);
     llvm::PHINode *phi = builder.CreatePHI(builder.getInt1Ty(), 2);
 
@@ -230,20 +571,54 @@ Codegen::generateBinaryOperator(const ResolvedBinaryOperator &binop) {
         phi->addIncoming(builder.getInt1(isOr), *it);
     }
 
-    return boolToDouble(phi);
+    return phi;
   }
 
   llvm::Value *lhs = generateExpr(*binop.lhs);
   llvm::Value *rhs = generateExpr(*binop.rhs);
 
+  // Exact integers are compared, added, subtracted and multiplied as i64,
+  // which can't overflow either.
+  bool isComparison = op == TokenKind::Lt || op == TokenKind::Gt ||
+                      op == TokenKind::EqualEqual;
+  if (isComparison ? ranges->isIntegral(*binop.lhs) &&
+                         ranges->isIntegral(*binop.rhs)
+                   : ranges->isIntegral(binop)) {
+    lhs = toInteger(lhs);
+    rhs = toInteger(rhs);
+
+    if (op == TokenKind::Lt)
+      return builder.CreateICmpSLT(lhs, rhs);
+
+    if (op == TokenKind::Gt)
+      return builder.CreateICmpSGT(lhs, rhs);
+
+    if (op == TokenKind::EqualEqual)
+      return builder.CreateICmpEQ(lhs, rhs);
+
+    if (op == TokenKind::Plus)
+      return builder.CreateNSWAdd(lhs, rhs);
+
+    if (op == TokenKind::Minus)
+      return builder.CreateNSWSub(lhs, rhs);
+
+    if (op == TokenKind::Asterisk)
+      return builder.CreateNSWMul(lhs, rhs);
+
+    llvm_unreachable("unexpected integer operator");
+  }
+
+  lhs = toDouble(lhs);
+  rhs = toDouble(rhs);
+
   if (op == TokenKind::Lt)
-    return boolToDouble(builder.CreateFCmpOLT(lhs, rhs));
+    return builder.CreateFCmpOLT(lhs, rhs);
 
   if (op == TokenKind::Gt)
-    return boolToDouble(builder.CreateFCmpOGT(lhs, rhs));
+    return builder.CreateFCmpOGT(lhs, rhs);
 
   if (op == TokenKind::EqualEqual)
-    return boolToDouble(builder.CreateFCmpOEQ(lhs, rhs));
+    return builder.CreateFCmpOEQ(lhs, rhs);
 
   if (op == TokenKind::Plus)
     return builder.CreateFAdd(lhs, rhs);
@@ -261,12 +636,42 @@ Codegen::generateBinaryOperator(const ResolvedBinaryOperator &binop) {
 }
 
 llvm::Value *Codegen::doubleToBool(llvm::Value *v) {
+  if (v->getType()->isIntegerTy(1))
+    return v;
+
+  if (v->getType()->isIntegerTy())
+    return builder.CreateICmpNE(v, builder.getInt64(0), "to.bool");
+
   return builder.CreateFCmpONE(
       v, llvm::ConstantFP::get(builder.getDoubleTy(), 0.0), "to.bool");
 }
 
-llvm::Value *Codegen::boolToDouble(llvm::Value *v) {
-  return builder.CreateUIToFP(v, builder.getDoubleTy(), "to.double");
+llvm::Value *Codegen::toDouble(llvm::Value *v) {
+  if (v->getType()->isDoubleTy())
+    return v;
+
+  if (v->getType()->isIntegerTy(1))
+    return builder.CreateUIToFP(v, builder.getDoubleTy(), "to.double");
+
+  return builder.CreateSIToFP(v, builder.getDoubleTy(), "to.double");
+}
+
+llvm::Value *Codegen::toInteger(llvm::Value *v) {
+  if (v->getType()->isIntegerTy(64))
+    return v;
+
+  if (v->getType()->isIntegerTy(1))
+    return builder.CreateZExt(v, builder.getInt64Ty(), "to.int");
+
+  // Only the values that are known to be exact integers are converted.
+  return builder.CreateFPToSI(v, builder.getInt64Ty(), "to.int");
+}
+
+llvm::Type *Codegen::getVariableType(const ResolvedDecl *decl) {
+  if (ranges && ranges->isIntegral(*decl))
+    return builder.getInt64Ty();
+
+  return builder.getDoubleTy();
 }
 
 llvm::Function *Codegen::getCurrentFunction() {
@@ -274,11 +679,150 @@ llvm::Function *Codegen::getCurrentFunction() {
 };
 
 llvm::AllocaInst *
-Codegen::allocateStackVariable(const std::string_view identifier) {
+Codegen::allocateStackVariable(const std::string_view identifier,
+                               llvm::Type *type) {
   llvm::IRBuilder<> tmpBuilder(context);
   tmpBuilder.SetInsertPoint(allocaInsertPoint);
 
-  return tmpBuilder.CreateAlloca(tmpBuilder.getDoubleTy(), nullptr, identifier);
+  return tmpBuilder.CreateAlloca(type, nullptr, identifier);
+}
+
+llvm::Value *Codegen::loadVariable(const ResolvedDecl *decl) {
+  if (!ssa) {
+    auto *var = llvm::cast<llvm::AllocaInst>(declarations[decl]);
+    return builder.CreateLoad(var->getAllocatedType(), var);
+  }
+
+  if (auto it = declarations.find(decl); it != declarations.end())
+    return it->second;
+
+  return readVariable(decl, builder.GetInsertBlock());
+}
+
+void Codegen::storeVariable(const ResolvedDecl *decl, llvm::Value *val) {
+  val = getVariableType(decl)->isIntegerTy() ? toInteger(val) : toDouble(val);
+
+  if (ssa) {
+    writeVariable(decl, builder.GetInsertBlock(), val);
+    return;
+  }
+
+  builder.CreateStore(val, declarations[decl]);
+}
+
+void Codegen::writeVariable(const ResolvedDecl *decl,
+                            llvm::BasicBlock *block,
+                            llvm::Value *val) {
+  currentDefs[{decl, block}] = val;
+}
+
+llvm::Value *Codegen::readVariable(const ResolvedDecl *decl,
+                                   llvm::BasicBlock *block) {
+  if (auto it = currentDefs.find({decl, block}); it != currentDefs.end())
+    return it->second;
+
+  return readVariableRecursive(decl, block);
+}
+
+llvm::Value *Codegen::readVariableRecursive(const ResolvedDecl *decl,
+                                            llvm::BasicBlock *block) {
+  // Blocks that have already been terminated can be left with a dangling
+  // branch after a return statement, which doesn't belong to any block.
+  llvm::SmallVector<llvm::BasicBlock *, 4> preds;
+  for (llvm::BasicBlock *pred : llvm::predecessors(block))
+    if (pred)
+      preds.emplace_back(pred);
+
+  llvm::Value *val = nullptr;
+  if (!sealedBlocks.count(block)) {
+    llvm::PHINode *phi = createPhi(decl, block);
+    incompletePhis[block].emplace_back(decl, phi);
+    val = phi;
+  } else if (preds.empty()) {
+    // The entry or an unreachable block, where the variable is not
+    // initialized.
+    val = llvm::UndefValue::get(getVariableType(decl));
+  } else if (preds.size() == 1) {
+    val = readVariable(decl, preds.front());
+  } else {
+    // The phi breaks the cycles of a loop, while its operands are read.
+    llvm::PHINode *phi = createPhi(decl, block);
+    writeVariable(decl, block, phi);
+    val = addPhiOperands(decl, phi);
+  }
+
+  writeVariable(decl, block, val);
+  return val;
+}
+
+llvm::PHINode *Codegen::createPhi(const ResolvedDecl *decl,
+                                  llvm::BasicBlock *block) {
+  std::string name = decl == currentFunction ? "retval" : decl->identifier;
+  llvm::Type *type = getVariableType(decl);
+  if (block->empty())
+    return llvm::PHINode::Create(type, 0, name, block);
+
+  return llvm::PHINode::Create(type, 0, name, &block->front());
+}
+
+llvm::Value *Codegen::addPhiOperands(const ResolvedDecl *decl,
+                                     llvm::PHINode *phi) {
+  for (llvm::BasicBlock *pred : llvm::predecessors(phi->getParent()))
+    if (pred)
+      phi->addIncoming(readVariable(decl, pred), pred);
+
+  return tryRemoveTrivialPhi(phi);
+}
+
+llvm::Value *Codegen::tryRemoveTrivialPhi(llvm::PHINode *phi) {
+  llvm::Value *same = nullptr;
+  for (llvm::Value *op : phi->incoming_values()) {
+    if (op == same || op == phi)
+      continue;
+
+    // The phi merges at least 2 different values.
+    if (same)
+      return phi;
+
+    same = op;
+  }
+
+  if (!same)
+    same = llvm::UndefValue::get(phi->getType());
+
+  // Replacing the phi can make the other phis that use it trivial too. The
+  // handles follow the replacements if one of them is removed meanwhile.
+  std::vector<llvm::WeakTrackingVH> users;
+  for (llvm::User *user : phi->users())
+    if (user != phi && llvm::isa<llvm::PHINode>(user))
+      users.emplace_back(user);
+
+  llvm::WeakTrackingVH result = same;
+  phi->replaceAllUsesWith(same);
+  phi->eraseFromParent();
+
+  for (auto &&user : users)
+    if (auto *userPhi = llvm::dyn_cast_or_null<llvm::PHINode>(user))
+      tryRemoveTrivialPhi(userPhi);
+
+  return result;
+}
+
+void Codegen::sealBlock(llvm::BasicBlock *block) {
+  if (!ssa)
+    return;
+
+  sealedBlocks.insert(block);
+
+  auto it = incompletePhis.find(block);
+  if (it == incompletePhis.end())
+    return;
+
+  auto phis = std::move(it->second);
+  incompletePhis.erase(it);
+
+  for (auto &&[decl, phi] : phis)
+    addPhiOperands(decl, phi);
 }
 
 void Codegen::generateBlock(const ResolvedBlock &block) {
@@ -290,17 +834,33 @@ void Codegen::generateBlock(const ResolvedBlock &block) {
     // The break ensures that no other instruction is generated that will be
     // inserted regardless of there is no insertion point and crash (e.g.:
     // CreateStore, CreateLoad).
-    if (dynamic_cast<const ResolvedReturnStmt *>(stmt.get())) {
+    if (dynamic_cast<const ResolvedReturnStmt *>(stmt.get()))
       builder.ClearInsertionPoint();
+
+    // The insertion point is also cleared after statements that never
+    // complete, like infinite loops or constant ifs whose executed arm
+    // returns.
+    if (!builder.GetInsertBlock())
       break;
-    }
   }
 }
 
 void Codegen::generateFunctionBody(const ResolvedFunctionDecl &functionDecl) {
   auto *function = module.getFunction(functionDecl.identifier);
+  currentFunction = &functionDecl;
+
+  currentDefs.clear();
+  sealedBlocks.clear();
+  coldBlocks.clear();
+  builder.setFastMathFlags(getFastMathFlags(functionDecl));
+
+  ranges.reset();
+  cfg.emplace(CFGBuilder(cee).build(functionDecl));
+  ranges.emplace(*cfg);
+  ranges->run();
 
   auto *entryBB = llvm::BasicBlock::Create(context, "entry", function);
+  sealBlock(entryBB);
   builder.SetInsertPoint(entryBB);
 
   // Note: llvm:Instruction has a protected destructor.
@@ -309,8 +869,9 @@ void Codegen::generateFunctionBody(const ResolvedFunctionDecl &functionDecl) {
                                             "alloca.placeholder", entryBB);
 
   bool isVoid = functionDecl.type.kind == Type::Kind::Void;
-  if (!isVoid)
-    retVal = allocateStackVariable("retval");
+  if (!isVoid && !ssa)
+    declarations[&functionDecl] =
+        allocateStackVariable("retval", builder.getDoubleTy());
   retBB = llvm::BasicBlock::Create(context, "return");
 
   int idx = 0;
@@ -318,33 +879,69 @@ void Codegen::generateFunctionBody(const ResolvedFunctionDecl &functionDecl) {
     const auto *paramDecl = functionDecl.params[idx].get();
     arg.setName(paramDecl->identifier);
 
-    llvm::Value *var = allocateStackVariable(paramDecl->identifier);
+    if (ssa) {
+      writeVariable(paramDecl, entryBB, &arg);
+      ++idx;
+      continue;
+    }
+
+    llvm::Value *var =
+        allocateStackVariable(paramDecl->identifier, builder.getDoubleTy());
     builder.CreateStore(&arg, var);
 
     declarations[paramDecl] = var;
     ++idx;
   }
 
+  tailRecursionBB = nullptr;
+  if (callGraph.isTailRecursive(functionDecl)) {
+    tailRecursionBB = llvm::BasicBlock::Create(context, "tailrecurse", function);
+    builder.CreateBr(tailRecursionBB);
+    builder.SetInsertPoint(tailRecursionBB);
+  }
+
   if (functionDecl.identifier == "println")
     generateBuiltinPrintlnBody(functionDecl);
   else
     generateBlock(*functionDecl.body);
 
+  if (tailRecursionBB)
+    sealBlock(tailRecursionBB);
+
   if (retBB->hasNPredecessorsOrMore(1)) {
     builder.CreateBr(retBB);
     retBB->insertInto(function);
+    sealBlock(retBB);
     builder.SetInsertPoint(retBB);
   }
 
+  assert(incompletePhis.empty() && "not every block is sealed");
+
+  // The hot paths fall through to each other, while the cold arms are moved
+  // after them in their original order.
+  std::vector<llvm::BasicBlock *> cold;
+  for (auto &&bb : *function)
+    if (coldBlocks.count(&bb))
+      cold.emplace_back(&bb);
+
+  for (llvm::BasicBlock *bb : cold)
+    bb->moveAfter(&function->back());
+
   allocaInsertPoint->eraseFromParent();
   allocaInsertPoint = nullptr;
 
+  // Every path ended in a tail call that returns on its own.
+  if (!builder.GetInsertBlock()) {
+    delete retBB;
+    return;
+  }
+
   if (isVoid) {
     builder.CreateRetVoid();
     return;
   }
 
-  builder.CreateRet(builder.CreateLoad(builder.getDoubleTy(), retVal));
+  builder.CreateRet(loadVariable(&functionDecl));
 }
 
 void Codegen::generateBuiltinPrintlnBody(const ResolvedFunctionDecl &println) {
@@ -354,19 +951,41 @@ void Codegen::generateBuiltinPrintlnBody(const ResolvedFunctionDecl &println) {
                                         "printf", module);
   auto *format = builder.CreateGlobalStringPtr("%.15g\n");
 
-  llvm::Value *param = builder.CreateLoad(
-      builder.getDoubleTy(), declarations[println.params[0].get()]);
+  llvm::Value *param = loadVariable(println.params[0].get());
 
   builder.CreateCall(printf, {format, param});
 }
 
+void Codegen::setTargetAttributes(llvm::Function &function) {
+  if (!targetCPU.empty())
+    function.addFnAttr("target-cpu", targetCPU);
+  if (!targetFeatures.empty())
+    function.addFnAttr("target-features", targetFeatures);
+}
+
+llvm::FastMathFlags
+Codegen::getFastMathFlags(const ResolvedFunctionDecl &function) {
+  llvm::FastMathFlags flags;
+  if (function.fpMode == FPMode::Fast)
+    flags.setFast();
+  else if (function.fpMode == FPMode::Default)
+    flags = fastMathFlags;
+
+  return flags;
+}
+
 void Codegen::generateMainWrapper() {
   auto *builtinMain = module.getFunction("main");
   builtinMain->setName("__builtin_main");
 
+  // The wrapper is generated next to the body.
+  if (builtinMain->isDeclaration())
+    return;
+
   auto *main = llvm::Function::Create(
       llvm::FunctionType::get(builder.getInt32Ty(), {}, false),
       llvm::Function::ExternalLinkage, "main", module);
+  setTargetAttributes(*main);
 
   auto *entry = llvm::BasicBlock::Create(context, "entry", main);
   builder.SetInsertPoint(entry);
@@ -383,19 +1002,128 @@ void Codegen::generateFunctionDecl(const ResolvedFunctionDecl &functionDecl) {
     paramTypes.emplace_back(generateType(param->type));
 
   auto *type = llvm::FunctionType::get(retType, paramTypes, false);
-  llvm::Function::Create(type, llvm::Function::ExternalLinkage,
-                         functionDecl.identifier, module);
+  auto *function = llvm::Function::Create(
+      type, llvm::Function::InternalLinkage, functionDecl.identifier, module);
+
+  // The functions are still not visible outside of the executable.
+  if (isPartitioned) {
+    function->setLinkage(llvm::Function::ExternalLinkage);
+    function->setVisibility(llvm::Function::HiddenVisibility);
+  }
+
+  // Nothing can unwind, and the effects of the function include everything
+  // it calls.
+  const FunctionEffects &effects = callGraph.getEffects(functionDecl);
+  function->setDoesNotThrow();
+  if (!effects.hasSideEffects)
+    function->setDoesNotAccessMemory();
+  if (!effects.isRecursive)
+    function->setDoesNotRecurse();
+  if (!effects.mayNotReturn)
+    function->setWillReturn();
+
+  setTargetAttributes(*function);
 }
 
-llvm::Module *Codegen::generateIR() {
-  for (auto &&function : resolvedTree)
+void Codegen::generateModule(
+    llvm::ArrayRef<const ResolvedFunctionDecl *> functions,
+    llvm::ArrayRef<const ResolvedFunctionDecl *> bodies) {
+  for (auto &&function : functions)
     generateFunctionDecl(*function);
 
-  for (auto &&function : resolvedTree)
+  for (auto &&function : bodies)
     generateFunctionBody(*function);
 
   generateMainWrapper();
 
-  return &module;
+  // The other partitions only see the functions this one calls.
+  for (llvm::Function &function : llvm::make_early_inc_range(module))
+    if (function.isDeclaration() && function.use_empty())
+      function.eraseFromParent();
+}
+
+std::vector<const ResolvedFunctionDecl *> Codegen::getGeneratedFunctions() {
+  const ResolvedFunctionDecl *main = nullptr;
+  for (auto &&function : resolvedTree)
+    if (function->identifier == "main")
+      main = function.get();
+
+  // Only the wrapper of 'main' is visible outside of the module, so the
+  // functions it can't reach are not generated.
+  assert(main && "no main function in the resolved tree");
+  std::vector<const ResolvedFunctionDecl *> functions =
+      callGraph.getReachableFunctions(*main);
+
+  if (keepUnreachable) {
+    functions.clear();
+    for (auto &&function : resolvedTree)
+      functions.emplace_back(function.get());
+  }
+
+  // The calls to likely and unlikely are replaced by their argument.
+  llvm::erase_if(functions, [](const ResolvedFunctionDecl *function) {
+    return isBuiltinExpect(*function);
+  });
+
+  return functions;
+}
+
+std::vector<llvm::Module *> Codegen::generatePartitions(
+    llvm::ArrayRef<const ResolvedFunctionDecl *> functions,
+    llvm::ArrayRef<std::vector<const ResolvedFunctionDecl *>> bodies,
+    unsigned threadCount) {
+  // This generator fills the first partition.
+  unsigned partitionCount = bodies.size();
+  isPartitioned = partitionCount > 1;
+  for (unsigned i = 1; i < partitionCount; ++i)
+    workers.emplace_back(new Codegen(*this));
+
+  parallelFor(threadCount, partitionCount, [&](unsigned, size_t idx) {
+    Codegen &generator = idx ? *workers[idx - 1] : *this;
+    generator.generateModule(functions, bodies[idx]);
+  });
+
+  std::vector<llvm::Module *> modules{&module};
+  for (auto &&worker : workers)
+    modules.emplace_back(&worker->module);
+
+  return modules;
+}
+
+std::vector<llvm::Module *> Codegen::generateIR(bool split,
+                                                unsigned threadCount) {
+  std::vector<const ResolvedFunctionDecl *> functions = getGeneratedFunctions();
+
+  // Every function goes to the same partition however many threads there are
+  // and however they are scheduled, so the modules are the same on every run.
+  size_t partitionCount =
+      split ? std::clamp<size_t>(functions.size(), 1, splitPartitionCount) : 1;
+  std::vector<std::vector<const ResolvedFunctionDecl *>> bodies(
+      partitionCount);
+  for (size_t i = 0; i < functions.size(); ++i)
+    bodies[i % partitionCount].emplace_back(functions[i]);
+
+  return generatePartitions(functions, bodies, threadCount);
+}
+
+std::vector<llvm::Module *>
+Codegen::generateIRPerSource(llvm::ArrayRef<std::string_view> sourcePaths,
+                             unsigned threadCount) {
+  std::vector<const ResolvedFunctionDecl *> functions = getGeneratedFunctions();
+
+  std::vector<std::vector<const ResolvedFunctionDecl *>> bodies(
+      sourcePaths.size());
+  for (auto &&function : functions) {
+    const auto *it = llvm::find(sourcePaths, function->location.filepath);
+    bodies[it == sourcePaths.end() ? 0 : it - sourcePaths.begin()]
+        .emplace_back(function);
+  }
+
+  std::vector<llvm::Module *> modules =
+      generatePartitions(functions, bodies, threadCount);
+  for (size_t i = 0; i < modules.size(); ++i)
+    modules[i]->setSourceFileName(sourcePaths[i]);
+
+  return modules;
 }
 } // namespace yl
@@ -1,17 +1,299 @@
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/bit.h>
+
+#include <algorithm>
+#include <cmath>
 #include <optional>
 
 #include "constexpr.h"
 
+namespace yl {
 namespace {
 std::optional<bool> toBool(std::optional<double> d) {
   if (!d)
     return std::nullopt;
 
-  return d != 0.0;
+  return yl::toBool(*d);
 }
 } // namespace
 
-namespace yl {
+bool toBool(double value) { return value != 0.0 && !std::isnan(value); }
+
+double applyBinaryOperator(TokenKind op, double lhs, double rhs) {
+  switch (op) {
+  case TokenKind::Asterisk:
+    return lhs * rhs;
+  case TokenKind::Slash:
+    return lhs / rhs;
+  case TokenKind::Plus:
+    return lhs + rhs;
+  case TokenKind::Minus:
+    return lhs - rhs;
+  case TokenKind::Lt:
+    return lhs < rhs;
+  case TokenKind::Gt:
+    return lhs > rhs;
+  case TokenKind::EqualEqual:
+    return lhs == rhs;
+  default:
+    llvm_unreachable("unexpected binary operator");
+  }
+}
+
+// Executes pure functions with constant arguments. The execution stops when
+// println is called or when the step or the call depth limit is exceeded.
+class ConstantExpressionEvaluator::Interpreter {
+  static constexpr unsigned callStepLimit = 1000000;
+  static constexpr unsigned depthLimit = 256;
+
+  enum class Flow { Next, Return, Stop };
+  using Frame = llvm::DenseMap<const ResolvedDecl *, double>;
+
+  std::map<CallKey, std::optional<double>> &results;
+  CallBudget &budget;
+  // The steps of a call are also limited by what is left of the budget.
+  unsigned stepLimit;
+  unsigned steps = 0;
+  unsigned depth = 0;
+  bool exhausted = false;
+
+  Frame *frame = nullptr;
+  double returnValue = 0.0;
+
+  bool step() {
+    exhausted |= ++steps > stepLimit;
+    return !exhausted;
+  }
+
+  Flow execute(const ResolvedBlock &block);
+  Flow execute(const ResolvedStmt &stmt);
+  std::optional<double> evaluate(const ResolvedExpr &expr);
+
+public:
+  Interpreter(std::map<CallKey, std::optional<double>> &results,
+              CallBudget &budget)
+      : results(results),
+        budget(budget),
+        stepLimit(std::min(callStepLimit, budget.remainingSteps)) {}
+
+  // Void functions return 0 if they could be executed.
+  std::optional<double> call(const ResolvedFunctionDecl &fn,
+                             llvm::ArrayRef<double> args);
+};
+
+std::optional<double>
+ConstantExpressionEvaluator::Interpreter::call(const ResolvedFunctionDecl &fn,
+                                               llvm::ArrayRef<double> args) {
+  CallKey key{&fn, {}};
+  for (auto &&arg : args)
+    key.second.emplace_back(llvm::bit_cast<uint64_t>(arg));
+
+  if (auto it = results.find(key); it != results.end())
+    return it->second;
+
+  std::optional<double> result;
+  unsigned entrySteps = steps;
+  if (fn.identifier != "println" && !budget.exhaustedFunctions.count(&fn) &&
+      depth < depthLimit && step()) {
+    Frame callFrame;
+    for (size_t i = 0; i < args.size(); ++i)
+      callFrame[fn.params[i].get()] = args[i];
+
+    Frame *callerFrame = std::exchange(frame, &callFrame);
+    ++depth;
+    Flow flow = execute(*fn.body);
+    --depth;
+    frame = callerFrame;
+
+    if (flow == Flow::Return)
+      result = returnValue;
+    else if (flow == Flow::Next && fn.type.kind == Type::Kind::Void)
+      result = 0.0;
+  }
+
+  // A function that used most of the steps of the call by itself is likely
+  // to run out of them with other arguments too.
+  if (exhausted && steps - entrySteps > callStepLimit / 2)
+    budget.exhaustedFunctions.insert(&fn);
+
+  // The limits are shared by the whole call tree, so a nested call that ran
+  // out of them might succeed on its own.
+  if (!exhausted || depth == 0)
+    results.emplace(std::move(key), result);
+
+  if (depth == 0)
+    budget.remainingSteps -= std::min(steps, budget.remainingSteps);
+
+  return result;
+}
+
+ConstantExpressionEvaluator::Interpreter::Flow
+ConstantExpressionEvaluator::Interpreter::execute(const ResolvedBlock &block) {
+  for (auto &&stmt : block.statements) {
+    Flow flow = execute(*stmt);
+    if (flow != Flow::Next)
+      return flow;
+  }
+
+  return Flow::Next;
+}
+
+ConstantExpressionEvaluator::Interpreter::Flow
+ConstantExpressionEvaluator::Interpreter::execute(const ResolvedStmt &stmt) {
+  if (!step())
+    return Flow::Stop;
+
+  if (const auto *expr = dynamic_cast<const ResolvedExpr *>(&stmt))
+    return evaluate(*expr) ? Flow::Next : Flow::Stop;
+
+  if (const auto *ifStmt = dynamic_cast<const ResolvedIfStmt *>(&stmt)) {
+    std::optional<bool> condition = toBool(evaluate(*ifStmt->condition));
+    if (!condition)
+      return Flow::Stop;
+
+    if (*condition)
+      return execute(*ifStmt->trueBlock);
+
+    return ifStmt->falseBlock ? execute(*ifStmt->falseBlock) : Flow::Next;
+  }
+
+  if (const auto *whileStmt = dynamic_cast<const ResolvedWhileStmt *>(&stmt)) {
+    while (true) {
+      std::optional<bool> condition = toBool(evaluate(*whileStmt->condition));
+      if (!condition)
+        return Flow::Stop;
+
+      if (!*condition)
+        return Flow::Next;
+
+      Flow flow = execute(*whileStmt->body);
+      if (flow != Flow::Next)
+        return flow;
+    }
+  }
+
+  if (const auto *declStmt = dynamic_cast<const ResolvedDeclStmt *>(&stmt)) {
+    const ResolvedVarDecl *var = declStmt->varDecl.get();
+    if (!var->initializer)
+      return Flow::Next;
+
+    std::optional<double> init = evaluate(*var->initializer);
+    if (!init)
+      return Flow::Stop;
+
+    (*frame)[var] = *init;
+    return Flow::Next;
+  }
+
+  if (const auto *assignment =
+          dynamic_cast<const ResolvedAssignment *>(&stmt)) {
+    std::optional<double> val = evaluate(*assignment->expr);
+    if (!val)
+      return Flow::Stop;
+
+    (*frame)[assignment->variable->decl] = *val;
+    return Flow::Next;
+  }
+
+  if (const auto *returnStmt =
+          dynamic_cast<const ResolvedReturnStmt *>(&stmt)) {
+    returnValue = 0.0;
+    if (!returnStmt->expr)
+      return Flow::Return;
+
+    std::optional<double> val = evaluate(*returnStmt->expr);
+    if (!val)
+      return Flow::Stop;
+
+    returnValue = *val;
+    return Flow::Return;
+  }
+
+  llvm_unreachable("unexpected statement");
+}
+
+std::optional<double>
+ConstantExpressionEvaluator::Interpreter::evaluate(const ResolvedExpr &expr) {
+  if (!step())
+    return std::nullopt;
+
+  if (std::optional<double> val = expr.getConstantValue())
+    return val;
+
+  if (const auto *numberLiteral =
+          dynamic_cast<const ResolvedNumberLiteral *>(&expr))
+    return numberLiteral->value;
+
+  if (const auto *dre = dynamic_cast<const ResolvedDeclRefExpr *>(&expr)) {
+    auto it = frame->find(dre->decl);
+    if (it == frame->end())
+      return std::nullopt;
+
+    return it->second;
+  }
+
+  if (const auto *callExpr = dynamic_cast<const ResolvedCallExpr *>(&expr)) {
+    std::vector<double> args;
+    for (auto &&arg : callExpr->arguments) {
+      std::optional<double> val = evaluate(*arg);
+      if (!val)
+        return std::nullopt;
+
+      args.emplace_back(*val);
+    }
+
+    return call(*callExpr->callee, args);
+  }
+
+  if (const auto *groupingExpr =
+          dynamic_cast<const ResolvedGroupingExpr *>(&expr))
+    return evaluate(*groupingExpr->expr);
+
+  if (const auto *binop = dynamic_cast<const ResolvedBinaryOperator *>(&expr)) {
+    if (binop->op == TokenKind::PipePipe || binop->op == TokenKind::AmpAmp) {
+      std::optional<bool> lhs = toBool(evaluate(*binop->lhs));
+      if (!lhs)
+        return std::nullopt;
+
+      // The RHS is only evaluated if the LHS doesn't decide the result.
+      if (*lhs == (binop->op == TokenKind::PipePipe))
+        return *lhs;
+
+      std::optional<bool> rhs = toBool(evaluate(*binop->rhs));
+      if (!rhs)
+        return std::nullopt;
+
+      return *rhs;
+    }
+
+    std::optional<double> lhs = evaluate(*binop->lhs);
+    if (!lhs)
+      return std::nullopt;
+
+    std::optional<double> rhs = evaluate(*binop->rhs);
+    if (!rhs)
+      return std::nullopt;
+
+    return applyBinaryOperator(binop->op, *lhs, *rhs);
+  }
+
+  if (const auto *unop = dynamic_cast<const ResolvedUnaryOperator *>(&expr)) {
+    std::optional<double> operand = evaluate(*unop->operand);
+    if (!operand)
+      return std::nullopt;
+
+    if (unop->op == TokenKind::Excl)
+      return !*toBool(operand);
+
+    if (unop->op == TokenKind::Minus)
+      return -*operand;
+
+    llvm_unreachable("unexpected unary operator");
+  }
+
+  llvm_unreachable("unexpected expression");
+}
+
 std::optional<double> ConstantExpressionEvaluator::evaluateBinaryOperator(
     const ResolvedBinaryOperator &binop, bool allowSideEffects) {
   std::optional<double> lhs = evaluate(*binop.lhs, allowSideEffects);
@@ -60,24 +342,7 @@ std::optional<double> ConstantExpressionEvaluator::evaluateBinaryOperator(
   if (!rhs)
     return std::nullopt;
 
-  switch (binop.op) {
-  case TokenKind::Asterisk:
-    return *lhs * *rhs;
-  case TokenKind::Slash:
-    return *lhs / *rhs;
-  case TokenKind::Plus:
-    return *lhs + *rhs;
-  case TokenKind::Minus:
-    return *lhs - *rhs;
-  case TokenKind::Lt:
-    return *lhs < *rhs;
-  case TokenKind::Gt:
-    return *lhs > *rhs;
-  case TokenKind::EqualEqual:
-    return *lhs == *rhs;
-  default:
-    llvm_unreachable("unexpected binary operator");
-  }
+  return applyBinaryOperator(binop.op, *lhs, *rhs);
 }
 
 std::optional<double> ConstantExpressionEvaluator::evaluateUnaryOperator(
@@ -107,16 +372,27 @@ ConstantExpressionEvaluator::evaluateDeclRefExpr(const ResolvedDeclRefExpr &dre,
 }
 
 std::optional<double>
-ConstantExpressionEvaluator::evaluate(const ResolvedExpr &expr,
-                                      bool allowSideEffects) {
-  // Don't evaluate the same expression multiple times.
-  if (std::optional<double> val = expr.getConstantValue())
-    return val;
+ConstantExpressionEvaluator::evaluateCallExpr(const ResolvedCallExpr &call,
+                                              bool allowSideEffects) {
+  if (!evaluateCalls || call.type.kind == Type::Kind::Void)
+    return std::nullopt;
 
-  if (const auto *numberLiteral =
-          dynamic_cast<const ResolvedNumberLiteral *>(&expr))
-    return numberLiteral->value;
+  std::vector<double> args;
+  for (auto &&arg : call.arguments) {
+    std::optional<double> val = evaluate(*arg, allowSideEffects);
+    if (!val)
+      return std::nullopt;
+
+    args.emplace_back(*val);
+  }
+
+  CallBudget &budget = sharedBudget ? *sharedBudget : ownBudget;
+  return Interpreter(callResults, budget).call(*call.callee, args);
+}
 
+std::optional<double>
+ConstantExpressionEvaluator::evaluateUncached(const ResolvedExpr &expr,
+                                              bool allowSideEffects) {
   if (const auto *groupingExpr =
           dynamic_cast<const ResolvedGroupingExpr *>(&expr))
     return evaluate(*groupingExpr->expr, allowSideEffects);
@@ -133,6 +409,31 @@ ConstantExpressionEvaluator::evaluate(const ResolvedExpr &expr,
           dynamic_cast<const ResolvedDeclRefExpr *>(&expr))
     return evaluateDeclRefExpr(*declRefExpr, allowSideEffects);
 
+  if (const auto *callExpr = dynamic_cast<const ResolvedCallExpr *>(&expr))
+    return evaluateCallExpr(*callExpr, allowSideEffects);
+
   return std::nullopt;
 }
+
+std::optional<double>
+ConstantExpressionEvaluator::evaluate(const ResolvedExpr &expr,
+                                      bool allowSideEffects) {
+  // Don't evaluate the same expression multiple times.
+  if (std::optional<double> val = expr.getConstantValue())
+    return val;
+
+  if (const auto *numberLiteral =
+          dynamic_cast<const ResolvedNumberLiteral *>(&expr))
+    return numberLiteral->value;
+
+  MemoKey key(&expr, allowSideEffects);
+  if (auto it = memo.find(key); it != memo.end())
+    return it->second;
+
+  // The memo can grow while the subexpressions are evaluated, so the result
+  // is inserted only after the evaluation.
+  std::optional<double> val = evaluateUncached(expr, allowSideEffects);
+  memo[key] = val;
+  return val;
+}
 } // namespace yl
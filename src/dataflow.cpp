@@ -0,0 +1,126 @@
+#include "dataflow.h"
+
+namespace yl {
+namespace {
+int nextPending(const llvm::BitVector &pending, int pos) {
+  int next = pending.find_next(pos);
+  return next != -1 ? next : pending.find_first();
+}
+} // namespace
+
+VariableNumbering::VariableNumbering(const CFG &cfg) {
+  for (int bb = 0; bb < cfg.getBlockCount(); ++bb) {
+    for (auto &&stmt : cfg.getStatements(bb)) {
+      const auto *decl = dynamic_cast<const ResolvedDeclStmt *>(stmt);
+      if (!decl)
+        continue;
+
+      indices[decl->varDecl.get()] = variables.size();
+      variables.emplace_back(decl->varDecl.get());
+    }
+  }
+}
+
+std::vector<int>
+getReversePostOrder(const CFG &cfg, bool backward, bool onlyReachableEdges) {
+  int blockCount = cfg.getBlockCount();
+
+  std::vector<int> postOrder;
+  std::vector<bool> visited(blockCount);
+
+  auto getNeighbours = [&](int bb) {
+    return backward ? cfg.getPredecessors(bb) : cfg.getSuccessors(bb);
+  };
+
+  // Iterative DFS, the stack holds the block and the index of the next
+  // neighbour to visit.
+  int root = backward ? cfg.exit : cfg.entry;
+  std::vector<std::pair<int, size_t>> stack;
+
+  visited[root] = true;
+  stack.emplace_back(root, 0);
+
+  while (!stack.empty()) {
+    auto &[bb, idx] = stack.back();
+
+    llvm::ArrayRef<CFGEdge> neighbours = getNeighbours(bb);
+    if (idx == neighbours.size()) {
+      postOrder.emplace_back(bb);
+      stack.pop_back();
+      continue;
+    }
+
+    CFGEdge edge = neighbours[idx++];
+    int next = edge.block;
+    if (visited[next] || (onlyReachableEdges && !edge.reachable))
+      continue;
+
+    visited[next] = true;
+    stack.emplace_back(next, 0);
+  }
+
+  std::vector<int> order(postOrder.rbegin(), postOrder.rend());
+  for (int bb = blockCount - 1; bb >= 0; --bb)
+    if (!visited[bb])
+      order.emplace_back(bb);
+
+  return order;
+}
+
+BitVectorDataflow::BitVectorDataflow(const CFG &cfg,
+                                     Direction direction,
+                                     unsigned width,
+                                     bool onlyReachableEdges)
+    : cfg(&cfg),
+      direction(direction),
+      onlyReachableEdges(onlyReachableEdges),
+      boundary(width),
+      in(cfg.getBlockCount(), llvm::BitVector(width)),
+      out(cfg.getBlockCount(), llvm::BitVector(width)) {}
+
+void BitVectorDataflow::solve(TransferFn transfer) {
+  bool backward = direction == Direction::Backward;
+  std::vector<int> order =
+      getReversePostOrder(*cfg, backward, onlyReachableEdges);
+
+  std::vector<int> position(order.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    position[order[i]] = i;
+
+  int root = backward ? cfg->exit : cfg->entry;
+
+  // Every block is visited at least once, after that only the blocks whose
+  // input might have changed. The blocks are swept in reverse post-order and
+  // the ones that become pending behind the current block, like the headers
+  // of loops, are only revisited in the next sweep.
+  llvm::BitVector pending(order.size(), true);
+  for (int pos = 0; pos != -1; pos = nextPending(pending, pos)) {
+    pending.reset(pos);
+    int bb = order[pos];
+
+    llvm::ArrayRef<CFGEdge> preds = cfg->getPredecessors(bb);
+    llvm::ArrayRef<CFGEdge> succs = cfg->getSuccessors(bb);
+    llvm::ArrayRef<CFGEdge> incoming = backward ? succs : preds;
+    llvm::ArrayRef<CFGEdge> outgoing = backward ? preds : succs;
+
+    llvm::BitVector state(boundary.size());
+    if (bb == root)
+      state |= boundary;
+
+    for (auto &&[neighbour, reachable] : incoming)
+      if (reachable || !onlyReachableEdges)
+        state |= out[neighbour];
+
+    in[bb] = state;
+    transfer(bb, state);
+
+    if (state == out[bb])
+      continue;
+
+    out[bb] = std::move(state);
+    for (auto &&[neighbour, reachable] : outgoing)
+      if (reachable || !onlyReachableEdges)
+        pending.set(position[neighbour]);
+  }
+}
+} // namespace yl
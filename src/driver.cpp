@@ -1,28 +1,83 @@
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/LTO/LTO.h>
+#include <llvm/MC/MCSubtargetInfo.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "cfg.h"
 #include "codegen.h"
+#include "dse.h"
+#include "inliner.h"
 #include "lexer.h"
+#include "licm.h"
+#include "loops.h"
 #include "parser.h"
 #include "sema.h"
+#include "specializer.h"
+#include "utils.h"
 
 using namespace yl;
 
 namespace {
 void displayHelp() {
   std::cout << "Usage:\n"
-            << "  compiler [options] <source_file>\n\n"
+            << "  compiler [options] <source_file>...\n\n"
             << "Options:\n"
-            << "  -h           display this message\n"
-            << "  -o <file>    write executable to <file>\n"
-            << "  -ast-dump    print the abstract syntax tree\n"
-            << "  -res-dump    print the resolved syntax tree\n"
-            << "  -llvm-dump   print the llvm module\n"
-            << "  -cfg-dump    print the control flow graph\n";
+            << "  -h              display this message\n"
+            << "  -o <file>       write the output to <file>\n"
+            << "  -c              write an object file\n"
+            << "  -S              write an assembly file\n"
+            << "  -emit-llvm      write the llvm module, as bitcode with -c\n"
+            << "  -emit-bc        write the llvm module as bitcode\n"
+            << "  -j <n>          generate the code on <n> threads\n"
+            << "  -ast-dump       print the abstract syntax tree\n"
+            << "  -res-dump       print the resolved syntax tree\n"
+            << "  -llvm-dump      print the llvm module\n"
+            << "  -cfg-dump       print the control flow graph\n"
+            << "  -cfg-dump-raw   print the unsimplified control flow graph\n"
+            << "  -loop-dump      print the loops of the control flow graph\n"
+            << "  -fssa           keep the variables in ssa form\n"
+            << "  -fno-ssa        keep every variable in a stack slot\n"
+            << "  -flicm          hoist invariant arithmetic out of loops\n"
+            << "  -fdse           remove stores whose value is never read\n"
+            << "  -finline        inline small non-recursive functions\n"
+            << "  -fspecialize    clone functions for constant arguments\n"
+            << "  -fkeep-unreachable\n"
+            << "                  generate the functions main can't reach\n"
+            << "  -fsyntax-only-reachable\n"
+            << "                  only check the functions main can reach\n"
+            << "  -ffast-math     allow every floating-point optimization\n"
+            << "  -ffp-contract=fast|off\n"
+            << "                  fuse multiplications and additions or not\n"
+            << "  -fno-signed-zeros\n"
+            << "                  ignore the sign of zeros\n"
+            << "  -freciprocal-math\n"
+            << "                  divide by multiplying with the reciprocal\n"
+            << "  -flto=full|thin\n"
+            << "                  optimize the sources together when linking\n"
+            << "  -march=<cpu>    target <cpu>, or the host with native\n"
+            << "  -mcpu=<cpu>     same as -march\n"
+            << "  -mattr=<attrs>  enable or disable features, like +fma\n"
+            << "  -Wunused-value  warn about stores that are never read\n";
 }
 
 [[noreturn]] void error(std::string_view msg) {
@@ -30,34 +85,75 @@ void displayHelp() {
   std::exit(1);
 }
 
+// Full LTO merges the sources into a single module, while ThinLTO only
+// imports the functions worth inlining into the modules of the callers.
+enum class LTOKind { None, Full, Thin };
+
+// What the single module of the program is written as, instead of being
+// linked into an executable.
+enum class OutputKind { Executable, Object, Assembly, LLVMIR, Bitcode };
+
 struct CompilerOptions {
-  std::filesystem::path source;
+  std::vector<std::filesystem::path> sources;
   std::filesystem::path output;
+  OutputKind outputKind = OutputKind::Executable;
+  // 0 hands the module to clang as bitcode.
+  unsigned jobs = 0;
   bool displayHelp = false;
   bool astDump = false;
   bool resDump = false;
   bool llvmDump = false;
   bool cfgDump = false;
+  bool cfgDumpRaw = false;
+  bool loopDump = false;
+  // Unset keeps the variables in SSA form only if they are optimized at
+  // link time. The unoptimized backend spills the values live across the
+  // phis, which makes hot loops slower than with stack slots.
+  std::optional<bool> ssa;
+  bool hoistInvariants = false;
+  bool eliminateDeadStores = false;
+  bool inlineFunctions = false;
+  bool specializeFunctions = false;
+  bool keepUnreachable = false;
+  bool checkOnlyReachable = false;
+  bool warnUnusedValues = false;
+  std::string targetCPU;
+  std::string targetFeatures;
+  llvm::FastMathFlags fastMathFlags;
+  LTOKind lto = LTOKind::None;
 };
 
 CompilerOptions parseArguments(int argc, const char **argv) {
   CompilerOptions options;
+  bool emitObject = false;
+  bool emitAssembly = false;
+  bool emitLLVM = false;
+  bool emitBitcode = false;
 
   int idx = 1;
   while (idx < argc) {
     std::string_view arg = argv[idx];
 
     if (arg[0] != '-') {
-      if (!options.source.empty())
-        error("unexpected argument '" + std::string(arg) + '\'');
-
-      options.source = arg;
+      options.sources.emplace_back(arg);
     } else {
       if (arg == "-h")
         options.displayHelp = true;
       else if (arg == "-o")
         options.output = ++idx >= argc ? "" : argv[idx];
-      else if (arg == "-ast-dump")
+      else if (arg == "-c")
+        emitObject = true;
+      else if (arg == "-S")
+        emitAssembly = true;
+      else if (arg == "-emit-llvm")
+        emitLLVM = true;
+      else if (arg == "-emit-bc")
+        emitBitcode = true;
+      else if (arg == "-j") {
+        if (++idx >= argc || !llvm::to_integer(argv[idx], options.jobs, 10) ||
+            options.jobs == 0)
+          error("expected a positive number of jobs after '-j'");
+      } else if (arg == "-ast-dump")
         options.astDump = true;
       else if (arg == "-res-dump")
         options.resDump = true;
@@ -65,6 +161,48 @@ CompilerOptions parseArguments(int argc, const char **argv) {
         options.llvmDump = true;
       else if (arg == "-cfg-dump")
         options.cfgDump = true;
+      else if (arg == "-cfg-dump-raw")
+        options.cfgDumpRaw = true;
+      else if (arg == "-loop-dump")
+        options.loopDump = true;
+      else if (arg == "-fssa")
+        options.ssa = true;
+      else if (arg == "-fno-ssa")
+        options.ssa = false;
+      else if (arg == "-flicm")
+        options.hoistInvariants = true;
+      else if (arg == "-fdse")
+        options.eliminateDeadStores = true;
+      else if (arg == "-finline")
+        options.inlineFunctions = true;
+      else if (arg == "-fspecialize")
+        options.specializeFunctions = true;
+      else if (arg == "-fkeep-unreachable")
+        options.keepUnreachable = true;
+      else if (arg == "-fsyntax-only-reachable")
+        options.checkOnlyReachable = true;
+      else if (arg == "-ffast-math")
+        options.fastMathFlags.setFast();
+      else if (arg == "-ffp-contract=fast")
+        options.fastMathFlags.setAllowContract(true);
+      else if (arg == "-ffp-contract=off")
+        options.fastMathFlags.setAllowContract(false);
+      else if (arg == "-fno-signed-zeros")
+        options.fastMathFlags.setNoSignedZeros();
+      else if (arg == "-freciprocal-math")
+        options.fastMathFlags.setAllowReciprocal();
+      else if (arg == "-flto=full")
+        options.lto = LTOKind::Full;
+      else if (arg == "-flto=thin")
+        options.lto = LTOKind::Thin;
+      else if (arg == "-Wunused-value")
+        options.warnUnusedValues = true;
+      else if (arg.substr(0, 7) == "-march=")
+        options.targetCPU = arg.substr(7);
+      else if (arg.substr(0, 6) == "-mcpu=")
+        options.targetCPU = arg.substr(6);
+      else if (arg.substr(0, 7) == "-mattr=")
+        options.targetFeatures = arg.substr(7);
       else
         error("unexpected option '" + std::string(arg) + '\'');
     }
@@ -72,8 +210,250 @@ CompilerOptions parseArguments(int argc, const char **argv) {
     ++idx;
   }
 
+  // Like in clang, -S takes precedence over -c, and -emit-llvm writes the
+  // module as text unless only -c is given.
+  if (emitBitcode || (emitLLVM && emitObject && !emitAssembly))
+    options.outputKind = OutputKind::Bitcode;
+  else if (emitLLVM)
+    options.outputKind = OutputKind::LLVMIR;
+  else if (emitAssembly)
+    options.outputKind = OutputKind::Assembly;
+  else if (emitObject)
+    options.outputKind = OutputKind::Object;
+
   return options;
 }
+
+std::unique_ptr<llvm::TargetMachine>
+createTargetMachine(const CompilerOptions &options) {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  std::string triple = llvm::sys::getDefaultTargetTriple();
+  std::string errorMsg;
+  const llvm::Target *target =
+      llvm::TargetRegistry::lookupTarget(triple, errorMsg);
+  if (!target)
+    error(errorMsg);
+
+  // 'native' is replaced by the processor of the host and the features it
+  // supports, which can still be changed with -mattr.
+  std::string cpu = options.targetCPU;
+  std::vector<std::string> features;
+  if (cpu == "native") {
+    cpu = llvm::sys::getHostCPUName().str();
+
+    llvm::StringMap<bool> hostFeatures;
+    if (llvm::sys::getHostCPUFeatures(hostFeatures))
+      for (auto &&feature : hostFeatures)
+        features.emplace_back((feature.second ? "+" : "-") +
+                              feature.first().str());
+    llvm::sort(features);
+  }
+
+  if (!options.targetFeatures.empty())
+    features.emplace_back(options.targetFeatures);
+
+  std::unique_ptr<llvm::MCSubtargetInfo> subtargetInfo(
+      target->createMCSubtargetInfo(triple, "", ""));
+  if (!cpu.empty() && !subtargetInfo->isCPUStringValid(cpu))
+    error("unknown target cpu '" + cpu + '\'');
+
+  // The objects are generated like clang does without an optimization level,
+  // for the position independent executables it links by default.
+  return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(
+      triple, cpu, llvm::join(features, ","), llvm::TargetOptions(),
+      llvm::Reloc::PIC_, llvm::None, llvm::CodeGenOpt::None));
+}
+
+// Generates the object files of the modules on 'jobs' threads, each with its
+// own copy of the target machine. Every module has its own context and every
+// thread writes its own file, so the objects are the same on every run.
+std::vector<std::string>
+generateObjects(llvm::ArrayRef<llvm::Module *> modules,
+                const llvm::TargetMachine &targetMachine, unsigned jobs,
+                const std::string &pathPrefix) {
+  std::vector<std::string> objectPaths;
+  for (size_t i = 0; i < modules.size(); ++i)
+    objectPaths.emplace_back(pathPrefix + '-' + std::to_string(i) + ".o");
+
+  std::vector<char> failed(modules.size());
+  parallelFor(jobs, modules.size(), [&](unsigned, size_t idx) {
+    std::unique_ptr<llvm::TargetMachine> copy(
+        targetMachine.getTarget().createTargetMachine(
+            targetMachine.getTargetTriple().str(),
+            targetMachine.getTargetCPU(),
+            targetMachine.getTargetFeatureString(), targetMachine.Options,
+            targetMachine.getRelocationModel(), targetMachine.getCodeModel(),
+            targetMachine.getOptLevel()));
+
+    std::error_code errorCode;
+    llvm::raw_fd_ostream object(objectPaths[idx], errorCode);
+
+    llvm::legacy::PassManager passManager;
+    failed[idx] = errorCode || copy->addPassesToEmitFile(
+                                   passManager, object, nullptr,
+                                   llvm::CGFT_ObjectFile);
+    if (!failed[idx])
+      passManager.run(*modules[idx]);
+  });
+
+  for (size_t i = 0; i < modules.size(); ++i)
+    if (failed[i])
+      error("failed to write '" + objectPaths[i] + '\'');
+
+  return objectPaths;
+}
+
+// Writes the modules as bitcode, with the summaries ThinLTO decides what to
+// import by, and generates the object files with the LTO backend. The
+// bitcode and the objects of ThinLTO are generated on 'jobs' threads. Only
+// 'main' is visible outside of the modules, so the backend can internalize
+// the other functions, inline them across the sources and remove the ones
+// that are no longer called.
+std::vector<std::string>
+optimizeAtLinkTime(llvm::ArrayRef<llvm::Module *> modules,
+                   const llvm::TargetMachine &targetMachine,
+                   LTOKind kind,
+                   unsigned jobs,
+                   const std::string &pathPrefix) {
+  std::vector<llvm::SmallVector<char, 0>> bitcode(modules.size());
+  parallelFor(jobs, modules.size(), [&](unsigned, size_t idx) {
+    llvm::raw_svector_ostream os(bitcode[idx]);
+    if (kind == LTOKind::Full) {
+      llvm::WriteBitcodeToFile(*modules[idx], os);
+      return;
+    }
+
+    // The summaries refer to the globals by their names, like the format
+    // string of println.
+    llvm::nameUnamedGlobals(*modules[idx]);
+
+    llvm::ProfileSummaryInfo profileSummary(*modules[idx]);
+    llvm::ModuleSummaryIndex index =
+        llvm::buildModuleSummaryIndex(*modules[idx], nullptr, &profileSummary);
+    llvm::WriteBitcodeToFile(*modules[idx], os,
+                             /*ShouldPreserveUseListOrder=*/false, &index);
+  });
+
+  llvm::lto::Config config;
+  config.CPU = targetMachine.getTargetCPU().str();
+  llvm::SmallVector<llvm::StringRef> features;
+  targetMachine.getTargetFeatureString().split(features, ',', -1, false);
+  for (auto &&feature : features)
+    config.MAttrs.emplace_back(feature.str());
+  config.Options = targetMachine.Options;
+  config.RelocModel = targetMachine.getRelocationModel();
+  config.DefaultTriple = targetMachine.getTargetTriple().str();
+  // The functions that are still exported after being inlined everywhere
+  // are removed by the linker.
+  config.Options.FunctionSections = true;
+
+  // Full LTO splits the combined module into as many objects as -j splits
+  // the program into, each generated on its own thread, so the executable
+  // doesn't depend on the number of jobs.
+  llvm::lto::ThinBackend backend;
+  if (kind == LTOKind::Thin)
+    backend = llvm::lto::createInProcessThinBackend(
+        llvm::heavyweight_hardware_concurrency(jobs));
+  llvm::lto::LTO lto(std::move(config), backend,
+                     /*ParallelCodeGenParallelismLevel=*/
+                     Codegen::splitPartitionCount);
+
+  for (size_t i = 0; i < modules.size(); ++i) {
+    llvm::MemoryBufferRef buffer(
+        llvm::StringRef(bitcode[i].data(), bitcode[i].size()),
+        modules[i]->getSourceFileName());
+    llvm::Expected<std::unique_ptr<llvm::lto::InputFile>> input =
+        llvm::lto::InputFile::create(buffer);
+    if (!input)
+      error(llvm::toString(input.takeError()));
+
+    std::vector<llvm::lto::SymbolResolution> resolutions;
+    for (auto &&symbol : (*input)->symbols()) {
+      llvm::lto::SymbolResolution &resolution = resolutions.emplace_back();
+      resolution.Prevailing = !symbol.isUndefined();
+      resolution.FinalDefinitionInLinkageUnit = !symbol.isUndefined();
+      resolution.VisibleToRegularObj = symbol.getName() == "main";
+    }
+
+    if (llvm::Error err = lto.add(std::move(*input), resolutions))
+      error(llvm::toString(std::move(err)));
+  }
+
+  // Every task writes its own object, and the tasks that have nothing to
+  // generate don't ask for one.
+  std::vector<std::string> objectPaths(lto.getMaxTasks());
+  auto addStream = [&](unsigned task)
+      -> llvm::Expected<std::unique_ptr<llvm::CachedFileStream>> {
+    objectPaths[task] = pathPrefix + '-' + std::to_string(task) + ".o";
+
+    std::error_code errorCode;
+    auto object =
+        std::make_unique<llvm::raw_fd_ostream>(objectPaths[task], errorCode);
+    if (errorCode)
+      return llvm::errorCodeToError(errorCode);
+
+    return std::make_unique<llvm::CachedFileStream>(std::move(object));
+  };
+
+  if (llvm::Error err = lto.run(addStream))
+    error(llvm::toString(std::move(err)));
+
+  llvm::erase_if(objectPaths, [](const std::string &path) {
+    return path.empty();
+  });
+  return objectPaths;
+}
+
+// Writes the module straight to the output, which is named after the first
+// source by default.
+void writeOutput(llvm::Module &module,
+                 llvm::TargetMachine &targetMachine,
+                 const CompilerOptions &options) {
+  OutputKind kind = options.outputKind;
+
+  std::filesystem::path output = options.output;
+  if (output.empty()) {
+    const char *extensions[] = {"", ".o", ".s", ".ll", ".bc"};
+    output = options.sources.front().filename();
+    output.replace_extension(extensions[static_cast<int>(kind)]);
+  }
+
+  bool isText = kind == OutputKind::Assembly || kind == OutputKind::LLVMIR;
+  std::error_code errorCode;
+  llvm::raw_fd_ostream os(output.string(), errorCode,
+                          isText ? llvm::sys::fs::OF_Text
+                                 : llvm::sys::fs::OF_None);
+  if (errorCode)
+    error("failed to open '" + output.string() + '\'');
+
+  if (kind == OutputKind::LLVMIR) {
+    module.print(os, nullptr);
+    return;
+  }
+
+  if (kind == OutputKind::Bitcode) {
+    llvm::WriteBitcodeToFile(module, os);
+    return;
+  }
+
+  // The object writer seeks back to fill in the headers, which a pipe can't
+  // do, so the file is buffered then.
+  std::optional<llvm::buffer_ostream> buffer;
+  llvm::raw_pwrite_stream *stream = &os;
+  if (!os.supportsSeeking())
+    stream = &buffer.emplace(os);
+
+  llvm::legacy::PassManager passManager;
+  if (targetMachine.addPassesToEmitFile(passManager, *stream, nullptr,
+                                        kind == OutputKind::Object
+                                            ? llvm::CGFT_ObjectFile
+                                            : llvm::CGFT_AssemblyFile))
+    error("failed to write '" + output.string() + '\'');
+
+  passManager.run(module);
+}
 } // namespace
 
 int main(int argc, const char **argv) {
@@ -84,23 +464,44 @@ int main(int argc, const char **argv) {
     return 0;
   }
 
-  if (options.source.empty())
+  if (options.sources.empty())
     error("no source file specified");
 
-  if (options.source.extension() != ".yl")
-    error("unexpected source file extension");
+  // The other outputs hold the single module of the whole program.
+  if (options.outputKind != OutputKind::Executable &&
+      (options.jobs || options.lto != LTOKind::None))
+    error("-j and -flto need an executable output");
 
-  std::ifstream file(options.source);
-  if (!file)
-    error("failed to open '" + options.source.string() + '\'');
+  std::vector<SourceFile> sourceFiles;
+  for (auto &&source : options.sources) {
+    if (source.extension() != ".yl")
+      error("unexpected source file extension");
 
-  std::stringstream buffer;
-  buffer << file.rdbuf();
-  SourceFile sourceFile{options.source.c_str(), buffer.str()};
+    std::ifstream file(source);
+    if (!file)
+      error("failed to open '" + source.string() + '\'');
 
-  Lexer lexer(sourceFile);
-  Parser parser(lexer);
-  auto [ast, success] = parser.parseSourceFile();
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    sourceFiles.emplace_back(SourceFile{source.c_str(), buffer.str()});
+  }
+
+  // The functions of every source share a single global scope, so 'main' is
+  // only missing if the last source doesn't declare it either.
+  std::vector<std::unique_ptr<FunctionDecl>> ast;
+  bool success = true;
+  for (auto &&sourceFile : sourceFiles) {
+    bool requireMain =
+        &sourceFile == &sourceFiles.back() &&
+        llvm::none_of(ast, [](auto &fn) { return fn->identifier == "main"; });
+
+    Lexer lexer(sourceFile);
+    Parser parser(lexer);
+    auto [functions, parsed] = parser.parseSourceFile(requireMain);
+
+    std::move(functions.begin(), functions.end(), std::back_inserter(ast));
+    success &= parsed;
+  }
 
   if (options.astDump) {
     for (auto &&fn : ast)
@@ -111,7 +512,8 @@ int main(int argc, const char **argv) {
   if (!success)
     return 1;
 
-  Sema sema(std::move(ast));
+  Sema sema(std::move(ast), options.checkOnlyReachable,
+            options.warnUnusedValues);
   auto resolvedTree = sema.resolveAST();
 
   if (options.resDump) {
@@ -120,10 +522,21 @@ int main(int argc, const char **argv) {
     return 0;
   }
 
-  if (options.cfgDump) {
+  if (options.cfgDump || options.cfgDumpRaw) {
+    ConstantExpressionEvaluator cee;
     for (auto &&fn : resolvedTree) {
       std::cerr << fn->identifier << ':' << '\n';
-      CFGBuilder().build(*fn).dump();
+      CFGBuilder(cee).build(*fn, /*simplified=*/!options.cfgDumpRaw).dump();
+    }
+    return 0;
+  }
+
+  if (options.loopDump) {
+    ConstantExpressionEvaluator cee;
+    for (auto &&fn : resolvedTree) {
+      std::cerr << fn->identifier << ':' << '\n';
+      CFG cfg = CFGBuilder(cee).build(*fn);
+      LoopInfo(cfg, DominatorTree(cfg)).dump();
     }
     return 0;
   }
@@ -131,31 +544,88 @@ int main(int argc, const char **argv) {
   if (resolvedTree.empty())
     return 1;
 
-  Codegen codegen(std::move(resolvedTree), options.source.c_str());
-  llvm::Module *llvmIR = codegen.generateIR();
+  // The stores that are removed don't have to be copied by the other passes.
+  if (options.eliminateDeadStores)
+    DeadStoreElimination(resolvedTree).run();
+
+  // The copies are specialized first, so the ones that got small enough can
+  // be inlined.
+  if (options.specializeFunctions)
+    Specializer(resolvedTree).run();
+
+  // The bodies are copied into the callers with the invariants already
+  // moved out of their loops.
+  if (options.hoistInvariants)
+    LoopInvariantCodeMotion(resolvedTree).run();
+
+  if (options.inlineFunctions)
+    Inliner(resolvedTree).run();
+
+  std::unique_ptr<llvm::TargetMachine> targetMachine =
+      createTargetMachine(options);
+  bool ssa = options.ssa.value_or(options.lto != LTOKind::None);
+  Codegen codegen(std::move(resolvedTree), options.sources.front().c_str(),
+                  *targetMachine, ssa, options.keepUnreachable,
+                  options.fastMathFlags);
+  std::vector<std::string_view> sourcePaths;
+  for (auto &&sourceFile : sourceFiles)
+    sourcePaths.emplace_back(sourceFile.path);
+
+  // Without -j, the LTO backend uses every core.
+  unsigned jobs = options.jobs;
+  if (!jobs && options.lto != LTOKind::None)
+    jobs = std::max(1u, std::thread::hardware_concurrency());
+
+  // The program is only split with -j, and the LTO backend combines the
+  // modules of the sources. The number of jobs doesn't change the modules.
+  std::vector<llvm::Module *> modules =
+      options.lto == LTOKind::None
+          ? codegen.generateIR(/*split=*/options.jobs != 0, std::max(1u, jobs))
+          : codegen.generateIRPerSource(sourcePaths, jobs);
 
   if (options.llvmDump) {
-    llvmIR->dump();
+    for (auto &&module : modules)
+      module->dump();
+    return 0;
+  }
+
+  if (options.outputKind != OutputKind::Executable) {
+    writeOutput(*modules.front(), *targetMachine, options);
     return 0;
   }
 
   // Theoretically this can still generate the same tmp files for 2 different
   // invocations and remove them later.
   std::stringstream path;
-  path << "tmp-" << std::filesystem::hash_value(options.source) << ".ll";
-  const std::string &llvmIRPath = path.str();
+  path << "tmp-" << std::filesystem::hash_value(options.sources.front());
 
-  std::error_code errorCode;
-  llvm::raw_fd_ostream f(llvmIRPath, errorCode);
-  llvmIR->print(f, nullptr);
+  std::vector<std::string> inputPaths;
+  if (options.lto != LTOKind::None) {
+    inputPaths = optimizeAtLinkTime(modules, *targetMachine, options.lto, jobs,
+                                    path.str());
+  } else if (options.jobs) {
+    inputPaths = generateObjects(modules, *targetMachine, jobs, path.str());
+  } else {
+    // Bitcode is quicker to write and for clang to read than textual IR.
+    inputPaths.emplace_back(path.str() + ".bc");
+
+    std::error_code errorCode;
+    llvm::raw_fd_ostream f(inputPaths.back(), errorCode);
+    llvm::WriteBitcodeToFile(*modules.front(), f);
+  }
 
   std::stringstream command;
-  command << "clang " << llvmIRPath;
+  command << "clang";
+  for (auto &&inputPath : inputPaths)
+    command << ' ' << inputPath;
+  if (options.lto != LTOKind::None)
+    command << " -Wl,--gc-sections";
   if (!options.output.empty())
     command << " -o " << options.output;
 
   int ret = std::system(command.str().c_str());
-  std::filesystem::remove(llvmIRPath);
+  for (auto &&inputPath : inputPaths)
+    std::filesystem::remove(inputPath);
 
   return ret;
 }
@@ -0,0 +1,89 @@
+#include "cfg.h"
+#include "constexpr.h"
+#include "dse.h"
+#include "liveness.h"
+
+namespace yl {
+void DeadStoreElimination::visit(std::unique_ptr<ResolvedExpr> &expr) {
+  if (const auto *dre = dynamic_cast<const ResolvedDeclRefExpr *>(expr.get()))
+    generatedReads.insert(dre);
+
+  walkOperands(*expr);
+}
+
+bool DeadStoreElimination::hasSideEffects(const ResolvedExpr &expr) const {
+  if (expr.getConstantValue())
+    return false;
+
+  // A call that doesn't print and always returns can be dropped.
+  if (const auto *call = dynamic_cast<const ResolvedCallExpr *>(&expr)) {
+    const FunctionEffects &effects = callGraph.getEffects(*call->callee);
+    if (effects.hasSideEffects || effects.mayNotReturn)
+      return true;
+
+    return llvm::any_of(call->arguments,
+                        [&](auto &&arg) { return hasSideEffects(*arg); });
+  }
+
+  if (const auto *grouping = dynamic_cast<const ResolvedGroupingExpr *>(&expr))
+    return hasSideEffects(*grouping->expr);
+
+  if (const auto *binop = dynamic_cast<const ResolvedBinaryOperator *>(&expr))
+    return hasSideEffects(*binop->lhs) || hasSideEffects(*binop->rhs);
+
+  if (const auto *unop = dynamic_cast<const ResolvedUnaryOperator *>(&expr))
+    return hasSideEffects(*unop->operand);
+
+  return false;
+}
+
+void DeadStoreElimination::removeDeadStores(ResolvedBlock &block) {
+  std::vector<std::unique_ptr<ResolvedStmt>> statements;
+
+  for (auto &&stmt : block.statements) {
+    if (auto *ifStmt = dynamic_cast<ResolvedIfStmt *>(stmt.get())) {
+      removeDeadStores(*ifStmt->trueBlock);
+      if (ifStmt->falseBlock)
+        removeDeadStores(*ifStmt->falseBlock);
+    } else if (auto *whileStmt =
+                   dynamic_cast<ResolvedWhileStmt *>(stmt.get())) {
+      removeDeadStores(*whileStmt->body);
+    } else if (deadStores.count(stmt.get())) {
+      std::unique_ptr<ResolvedExpr> expr;
+      if (auto *declStmt = dynamic_cast<ResolvedDeclStmt *>(stmt.get()))
+        expr = std::move(declStmt->varDecl->initializer);
+      else
+        expr = std::move(static_cast<ResolvedAssignment &>(*stmt).expr);
+
+      // The declaration is kept without its initializer.
+      if (dynamic_cast<ResolvedDeclStmt *>(stmt.get()))
+        statements.emplace_back(std::move(stmt));
+
+      if (hasSideEffects(*expr))
+        statements.emplace_back(std::move(expr));
+      continue;
+    }
+
+    statements.emplace_back(std::move(stmt));
+  }
+
+  block.statements = std::move(statements);
+}
+
+void DeadStoreElimination::run() {
+  for (auto &&fn : *resolvedTree) {
+    generatedReads.clear();
+    walk(*fn->body);
+
+    ConstantExpressionEvaluator cee;
+    CFG cfg = CFGBuilder(cee).build(*fn);
+    std::vector<const ResolvedStmt *> stores =
+        findDeadStores(cfg, [&](const ResolvedDeclRefExpr &dre) {
+          return generatedReads.count(&dre) != 0;
+        });
+
+    deadStores = {stores.begin(), stores.end()};
+    removeDeadStores(*fn->body);
+  }
+}
+} // namespace yl
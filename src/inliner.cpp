@@ -0,0 +1,65 @@
+#include "inliner.h"
+
+namespace yl {
+bool Inliner::shouldInline(const ResolvedCallExpr &call) const {
+  const ResolvedFunctionDecl &callee = *call.callee;
+
+  // The builtin println has no body to copy, and copying the body of likely
+  // or unlikely would drop the hint.
+  if (isBuiltin(callee))
+    return false;
+
+  // The functions of the caller's component are not visited yet, and copying
+  // a recursive function would never end.
+  if (callGraph.getEffects(callee).isRecursive)
+    return false;
+
+  auto it = sizes.find(&callee);
+  return it != sizes.end() && it->second <= sizeThreshold;
+}
+
+std::unique_ptr<ResolvedExpr> Inliner::inlineCall(ResolvedCallExpr &call) {
+  const ResolvedFunctionDecl &callee = *call.callee;
+  TreeCloner cloner;
+
+  // Every parameter is replaced by an immutable variable that is initialized
+  // with the argument, so the arguments are still evaluated once and in
+  // order.
+  std::vector<std::unique_ptr<ResolvedDeclStmt>> arguments;
+  for (size_t i = 0; i < callee.params.size(); ++i) {
+    const ResolvedParamDecl &param = *callee.params[i];
+
+    auto varDecl = std::make_unique<ResolvedVarDecl>(
+        param.location, param.identifier, param.type, /*isMutable=*/false,
+        std::move(call.arguments[i]));
+    cloner.replace(param, *varDecl);
+
+    arguments.emplace_back(std::make_unique<ResolvedDeclStmt>(
+        call.location, std::move(varDecl)));
+  }
+
+  auto body = cloner.clone(*callee.body);
+
+  return std::make_unique<ResolvedInlinedCallExpr>(
+      call.location, callee, std::move(arguments), std::move(body));
+}
+
+void Inliner::visit(std::unique_ptr<ResolvedExpr> &expr) {
+  walkOperands(*expr);
+
+  if (auto *call = dynamic_cast<ResolvedCallExpr *>(expr.get());
+      call && shouldInline(*call))
+    expr = inlineCall(*call);
+}
+
+void Inliner::run() {
+  for (auto &&scc : callGraph.getSCCs()) {
+    for (const ResolvedFunctionDecl *fn : scc) {
+      // The call graph only refers to the functions as constants.
+      auto *body = const_cast<ResolvedBlock *>(fn->body.get());
+      walk(*body);
+      sizes[fn] = getSize(*body);
+    }
+  }
+}
+} // namespace yl
@@ -0,0 +1,132 @@
+#include <llvm/ADT/ArrayRef.h>
+
+#include "cfg.h"
+#include "constexpr.h"
+#include "licm.h"
+#include "loops.h"
+
+namespace yl {
+namespace {
+// Conditions are generated as i1 values, which would have to be converted to
+// numbers to be stored in a variable, so only arithmetic is worth moving.
+bool isArithmetic(const ResolvedExpr &expr) {
+  if (const auto *grouping = dynamic_cast<const ResolvedGroupingExpr *>(&expr))
+    return isArithmetic(*grouping->expr);
+
+  if (const auto *binop = dynamic_cast<const ResolvedBinaryOperator *>(&expr))
+    return binop->op == TokenKind::Plus || binop->op == TokenKind::Minus ||
+           binop->op == TokenKind::Asterisk || binop->op == TokenKind::Slash;
+
+  if (const auto *unop = dynamic_cast<const ResolvedUnaryOperator *>(&expr))
+    return unop->op == TokenKind::Minus;
+
+  return false;
+}
+} // namespace
+
+void LoopInvariantCodeMotion::findLoops(const ResolvedFunctionDecl &fn) {
+  // In the unsimplified CFG the header of every loop ends with its while
+  // statement.
+  ConstantExpressionEvaluator cee;
+  CFG cfg = CFGBuilder(cee).build(fn, /*simplified=*/false);
+  DominatorTree domTree(cfg);
+  LoopInfo loopInfo(cfg, domTree);
+
+  for (auto &&loop : loopInfo.getLoops()) {
+    llvm::ArrayRef<const ResolvedStmt *> stmts =
+        cfg.getStatements(loop->header);
+    const auto *whileStmt =
+        stmts.empty() ? nullptr
+                      : dynamic_cast<const ResolvedWhileStmt *>(stmts.back());
+    if (!whileStmt)
+      continue;
+
+    LoopContents &contents = loops[whileStmt];
+    for (int bb : loop->blocks) {
+      for (auto &&stmt : cfg.getStatements(bb)) {
+        contents.statements.insert(stmt);
+
+        if (const auto *declStmt = dynamic_cast<const ResolvedDeclStmt *>(stmt))
+          contents.definitions.insert(declStmt->varDecl.get());
+        else if (const auto *assignment =
+                     dynamic_cast<const ResolvedAssignment *>(stmt))
+          contents.definitions.insert(assignment->variable->decl);
+      }
+    }
+  }
+}
+
+bool LoopInvariantCodeMotion::isInvariant(const ResolvedExpr &expr,
+                                          const LoopContents &loop) const {
+  if (expr.getConstantValue() ||
+      dynamic_cast<const ResolvedNumberLiteral *>(&expr))
+    return true;
+
+  if (const auto *dre = dynamic_cast<const ResolvedDeclRefExpr *>(&expr))
+    return !loop.definitions.count(dre->decl);
+
+  if (const auto *grouping = dynamic_cast<const ResolvedGroupingExpr *>(&expr))
+    return isInvariant(*grouping->expr, loop);
+
+  if (const auto *binop = dynamic_cast<const ResolvedBinaryOperator *>(&expr))
+    return isInvariant(*binop->lhs, loop) && isInvariant(*binop->rhs, loop);
+
+  if (const auto *unop = dynamic_cast<const ResolvedUnaryOperator *>(&expr))
+    return isInvariant(*unop->operand, loop);
+
+  // Calls can have side effects, so they are evaluated on every iteration.
+  return false;
+}
+
+void LoopInvariantCodeMotion::visit(std::unique_ptr<ResolvedExpr> &expr) {
+  if (!isArithmetic(*expr) || !currentLoop->statements.count(expr.get()) ||
+      !isInvariant(*expr, *currentLoop))
+    return walkOperands(*expr);
+
+  SourceLocation location = expr->location;
+  auto var = std::make_unique<ResolvedVarDecl>(
+      location, "invariant", expr->type, /*isMutable=*/false, std::move(expr));
+
+  expr = std::make_unique<ResolvedDeclRefExpr>(location, *var);
+  preheader->emplace_back(
+      std::make_unique<ResolvedDeclStmt>(location, std::move(var)));
+}
+
+void LoopInvariantCodeMotion::hoistInvariants(ResolvedBlock &block) {
+  std::vector<std::unique_ptr<ResolvedStmt>> statements;
+
+  for (auto &&stmt : block.statements) {
+    if (auto *ifStmt = dynamic_cast<ResolvedIfStmt *>(stmt.get())) {
+      hoistInvariants(*ifStmt->trueBlock);
+      if (ifStmt->falseBlock)
+        hoistInvariants(*ifStmt->falseBlock);
+    } else if (auto *whileStmt =
+                   dynamic_cast<ResolvedWhileStmt *>(stmt.get())) {
+      // The expressions are moved out of the outermost loop they are
+      // invariant in first, then the nested loops are visited.
+      std::optional<double> cond = whileStmt->condition->getConstantValue();
+      auto it = loops.find(whileStmt);
+      if (it != loops.end() && (!cond || toBool(*cond))) {
+        currentLoop = &it->second;
+        preheader = &statements;
+        walk(whileStmt->condition);
+        walk(*whileStmt->body);
+      }
+
+      hoistInvariants(*whileStmt->body);
+    }
+
+    statements.emplace_back(std::move(stmt));
+  }
+
+  block.statements = std::move(statements);
+}
+
+void LoopInvariantCodeMotion::run() {
+  for (auto &&fn : *resolvedTree) {
+    loops.clear();
+    findLoops(*fn);
+    hoistInvariants(*fn->body);
+  }
+}
+} // namespace yl
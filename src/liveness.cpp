@@ -0,0 +1,69 @@
+#include <algorithm>
+
+#include "dataflow.h"
+#include "liveness.h"
+
+namespace yl {
+std::vector<const ResolvedStmt *>
+findDeadStores(const CFG &cfg,
+               llvm::function_ref<bool(const ResolvedDeclRefExpr &)> isRead) {
+  VariableNumbering variables(cfg);
+  std::vector<const ResolvedStmt *> deadStores;
+
+  // The statements of the block are walked backwards, from the variables
+  // that are live after the block to the ones live before it.
+  auto transfer = [&](int bb, llvm::BitVector &live, bool collectStores) {
+    llvm::ArrayRef<const ResolvedStmt *> stmts = cfg.getStatements(bb);
+
+    for (auto it = stmts.rbegin(); it != stmts.rend(); ++it) {
+      const ResolvedVarDecl *var = nullptr;
+
+      if (const auto *decl = dynamic_cast<const ResolvedDeclStmt *>(*it)) {
+        var = decl->varDecl.get();
+
+        // A declaration without an initializer stores nothing, but the
+        // variable doesn't exist before it either.
+        if (!var->initializer) {
+          live.reset(variables.getIndex(var));
+          continue;
+        }
+      } else if (const auto *assignment =
+                     dynamic_cast<const ResolvedAssignment *>(*it)) {
+        var = dynamic_cast<const ResolvedVarDecl *>(assignment->variable->decl);
+      } else if (const auto *dre =
+                     dynamic_cast<const ResolvedDeclRefExpr *>(*it)) {
+        const auto *readVar = dynamic_cast<const ResolvedVarDecl *>(dre->decl);
+        if (readVar && isRead(*dre))
+          live.set(variables.getIndex(readVar));
+        continue;
+      }
+
+      if (!var)
+        continue;
+
+      unsigned idx = variables.getIndex(var);
+      if (collectStores && !live.test(idx))
+        deadStores.emplace_back(*it);
+      live.reset(idx);
+    }
+  };
+
+  BitVectorDataflow liveness(cfg, BitVectorDataflow::Direction::Backward,
+                             variables.size());
+  liveness.solve([&](int bb, llvm::BitVector &live) {
+    transfer(bb, live, false);
+  });
+
+  // The stores are only collected once the fixpoint has been reached. The
+  // blocks are built bottom-up, so walking them from the highest index visits
+  // the statements in source order.
+  for (int bb = cfg.getBlockCount() - 1; bb >= 0; --bb) {
+    size_t first = deadStores.size();
+    llvm::BitVector live = liveness.getIn(bb);
+    transfer(bb, live, true);
+    std::reverse(deadStores.begin() + first, deadStores.end());
+  }
+
+  return deadStores;
+}
+} // namespace yl
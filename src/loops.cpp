@@ -0,0 +1,190 @@
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/STLExtras.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+#include "dataflow.h"
+#include "loops.h"
+
+namespace yl {
+namespace {
+void dumpBlocks(llvm::ArrayRef<int> blocks) {
+  for (int bb : blocks)
+    std::cerr << bb << ' ';
+  std::cerr << '\n';
+}
+} // namespace
+
+DominatorTree::DominatorTree(const CFG &cfg) {
+  int blockCount = cfg.getBlockCount();
+
+  std::vector<int> order = getReversePostOrder(cfg);
+  positions.resize(blockCount);
+  for (size_t i = 0; i < order.size(); ++i)
+    positions[order[i]] = i;
+
+  // The entry is its own dominator until the tree is built, which marks it
+  // reachable.
+  idoms.assign(blockCount, -1);
+  idoms[cfg.entry] = cfg.entry;
+
+  // Walks up from both blocks to their nearest common dominator. The
+  // dominators of a block come before it in reverse post-order.
+  auto intersect = [&](int lhs, int rhs) {
+    while (lhs != rhs) {
+      while (positions[lhs] > positions[rhs])
+        lhs = idoms[lhs];
+      while (positions[rhs] > positions[lhs])
+        rhs = idoms[rhs];
+    }
+    return lhs;
+  };
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    for (int bb : order) {
+      if (bb == cfg.entry)
+        continue;
+
+      int idom = -1;
+      for (auto &&[pred, reachable] : cfg.getPredecessors(bb)) {
+        if (idoms[pred] == -1)
+          continue;
+
+        idom = idom == -1 ? pred : intersect(pred, idom);
+      }
+
+      if (idom != idoms[bb]) {
+        idoms[bb] = idom;
+        changed = true;
+      }
+    }
+  }
+}
+
+int DominatorTree::getImmediateDominator(int block) const {
+  return idoms[block] == block ? -1 : idoms[block];
+}
+
+bool DominatorTree::dominates(int dominator, int block) const {
+  if (!isReachable(block))
+    return false;
+
+  while (positions[block] > positions[dominator])
+    block = idoms[block];
+
+  return block == dominator;
+}
+
+bool Loop::contains(int block) const {
+  return std::binary_search(blocks.begin(), blocks.end(), block);
+}
+
+unsigned Loop::getDepth() const {
+  unsigned depth = 1;
+  for (const Loop *loop = parent; loop; loop = loop->parent)
+    ++depth;
+
+  return depth;
+}
+
+std::vector<int> Loop::getExits(const CFG &cfg) const {
+  std::vector<int> exits;
+  for (int bb : blocks)
+    for (auto &&[succ, reachable] : cfg.getSuccessors(bb))
+      if (!contains(succ))
+        exits.emplace_back(succ);
+
+  llvm::sort(exits);
+  exits.erase(std::unique(exits.begin(), exits.end()), exits.end());
+  return exits;
+}
+
+void Loop::dump(const CFG &cfg) const {
+  unsigned depth = getDepth();
+  std::string indent((depth - 1) * 2, ' ');
+
+  std::cerr << indent << "loop [" << header << "] depth " << depth << '\n';
+
+  std::cerr << indent << "  latches: ";
+  dumpBlocks(latches);
+
+  std::cerr << indent << "  blocks: ";
+  dumpBlocks(blocks);
+
+  std::cerr << indent << "  exits: ";
+  dumpBlocks(getExits(cfg));
+
+  for (auto &&subLoop : subLoops)
+    subLoop->dump(cfg);
+}
+
+LoopInfo::LoopInfo(const CFG &cfg, const DominatorTree &domTree)
+    : cfg(&cfg),
+      innermostLoops(cfg.getBlockCount()) {
+  int blockCount = cfg.getBlockCount();
+
+  // The header of a loop dominates the headers of the loops nested in it,
+  // so the enclosing loops are found first.
+  for (int header : getReversePostOrder(cfg)) {
+    if (!domTree.isReachable(header))
+      continue;
+
+    std::vector<int> latches;
+    for (auto &&[pred, reachable] : cfg.getPredecessors(header))
+      if (domTree.dominates(header, pred) && !llvm::is_contained(latches, pred))
+        latches.emplace_back(pred);
+
+    if (latches.empty())
+      continue;
+
+    auto loop = std::make_unique<Loop>(header);
+    llvm::sort(latches);
+    loop->latches = latches;
+
+    // The blocks that reach a latch backwards without crossing the header.
+    std::vector<bool> inLoop(blockCount);
+    inLoop[header] = true;
+
+    std::vector<int> worklist = std::move(latches);
+    while (!worklist.empty()) {
+      int bb = worklist.back();
+      worklist.pop_back();
+
+      if (inLoop[bb])
+        continue;
+      inLoop[bb] = true;
+
+      for (auto &&[pred, reachable] : cfg.getPredecessors(bb))
+        if (domTree.isReachable(pred) && !inLoop[pred])
+          worklist.emplace_back(pred);
+    }
+
+    for (int bb = 0; bb < blockCount; ++bb)
+      if (inLoop[bb])
+        loop->blocks.emplace_back(bb);
+
+    loop->parent = innermostLoops[header];
+    if (loop->parent)
+      loop->parent->subLoops.emplace_back(loop.get());
+    else
+      topLevelLoops.emplace_back(loop.get());
+
+    for (int bb : loop->blocks)
+      innermostLoops[bb] = loop.get();
+
+    loops.emplace_back(std::move(loop));
+  }
+}
+
+void LoopInfo::dump() const {
+  for (auto &&loop : topLevelLoops) {
+    loop->dump(*cfg);
+    std::cerr << '\n';
+  }
+}
+} // namespace yl
@@ -59,7 +59,8 @@ void Parser::synchronize() {
     } else if (kind == TokenKind::Semi && braces == 0) {
       eatNextToken(); // eat ';'
       break;
-    } else if (kind == TokenKind::KwFn || kind == TokenKind::Eof)
+    } else if (kind == TokenKind::KwFn || kind == TokenKind::At ||
+               kind == TokenKind::Eof)
       break;
 
     eatNextToken();
@@ -67,8 +68,36 @@ void Parser::synchronize() {
 }
 
 // <functionDecl>
-//  ::= 'fn' <identifier> <parameterList> ':' <type> <block>
+//  ::= <attribute>* 'fn' <identifier> <parameterList> ':' <type> <block>
+//
+// <attribute>
+//  ::= '@' ('fastmath' | 'strictfp')
 std::unique_ptr<FunctionDecl> Parser::parseFunctionDecl() {
+  FPMode fpMode = FPMode::Default;
+  while (nextToken.kind == TokenKind::At) {
+    eatNextToken(); // eat '@'
+
+    matchOrReturn(TokenKind::Identifier, "expected attribute");
+    assert(nextToken.value && "identifier token without value");
+
+    FPMode mode;
+    if (*nextToken.value == "fastmath")
+      mode = FPMode::Fast;
+    else if (*nextToken.value == "strictfp")
+      mode = FPMode::Strict;
+    else
+      return report(nextToken.location,
+                    "unknown attribute '" + *nextToken.value + '\'');
+
+    if (fpMode != FPMode::Default && fpMode != mode)
+      return report(nextToken.location,
+                    "conflicting floating-point attributes");
+
+    fpMode = mode;
+    eatNextToken(); // eat identifier
+  }
+
+  matchOrReturn(TokenKind::KwFn, "expected 'fn'");
   SourceLocation location = nextToken.location;
   eatNextToken(); // eat fn
 
@@ -90,7 +119,7 @@ std::unique_ptr<FunctionDecl> Parser::parseFunctionDecl() {
 
   return std::make_unique<FunctionDecl>(location, functionIdentifier, *type,
                                         std::move(*parameterList),
-                                        std::move(block));
+                                        std::move(block), fpMode);
 }
 
 // <paramDecl>
@@ -151,7 +180,8 @@ std::unique_ptr<Block> Parser::parseBlock() {
     if (nextToken.kind == TokenKind::Rbrace)
       break;
 
-    if (nextToken.kind == TokenKind::Eof || nextToken.kind == TokenKind::KwFn)
+    if (nextToken.kind == TokenKind::Eof || nextToken.kind == TokenKind::KwFn ||
+        nextToken.kind == TokenKind::At)
       return report(nextToken.location, "expected '}' at the end of a block");
 
     std::unique_ptr<Stmt> stmt = parseStmt();
@@ -506,20 +536,20 @@ std::optional<Type> Parser::parseType() {
 // <sourceFile>
 //     ::= <functionDecl>* EOF
 std::pair<std::vector<std::unique_ptr<FunctionDecl>>, bool>
-Parser::parseSourceFile() {
+Parser::parseSourceFile(bool requireMain) {
   std::vector<std::unique_ptr<FunctionDecl>> functions;
 
   while (nextToken.kind != TokenKind::Eof) {
-    if (nextToken.kind != TokenKind::KwFn) {
+    if (nextToken.kind != TokenKind::KwFn && nextToken.kind != TokenKind::At) {
       report(nextToken.location,
              "only function declarations are allowed on the top level");
-      synchronizeOn(TokenKind::KwFn);
+      synchronizeOnFunctionDecl();
       continue;
     }
 
     auto fn = parseFunctionDecl();
     if (!fn) {
-      synchronizeOn(TokenKind::KwFn);
+      synchronizeOnFunctionDecl();
       continue;
     }
 
@@ -534,9 +564,10 @@ Parser::parseSourceFile() {
   for (auto &&fn : functions)
     hasMainFunction |= fn->identifier == "main";
 
-  if (!hasMainFunction && !incompleteAST)
+  if (requireMain && !hasMainFunction && !incompleteAST)
     report(nextToken.location, "main function not found");
 
-  return {std::move(functions), !incompleteAST && hasMainFunction};
+  return {std::move(functions),
+          !incompleteAST && (hasMainFunction || !requireMain)};
 }
 } // namespace yl
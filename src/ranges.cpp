@@ -0,0 +1,418 @@
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/MathExtras.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "constexpr.h"
+#include "ranges.h"
+
+namespace yl {
+namespace {
+using Range = IntegerRangeAnalysis::Range;
+
+Range meet(const Range &lhs, const Range &rhs) {
+  if (lhs.kind == Range::Kind::Undefined)
+    return rhs;
+
+  if (rhs.kind == Range::Kind::Undefined)
+    return lhs;
+
+  if (!lhs.isIntegral() || !rhs.isIntegral())
+    return Range::getOverdefined();
+
+  return Range::getIntegral(std::min(lhs.lo, rhs.lo),
+                            std::max(lhs.hi, rhs.hi));
+}
+
+// The bounds that grew since the last visit of a loop header are moved to the
+// end of the exact range, so every loop reaches a fixpoint in a few sweeps.
+Range widen(const Range &previous, const Range &current) {
+  if (previous.kind == Range::Kind::Undefined)
+    return current;
+
+  Range range = meet(previous, current);
+  if (!range.isIntegral())
+    return range;
+
+  const int64_t max = IntegerRangeAnalysis::maxExactInteger;
+  return Range::getIntegral(current.lo < previous.lo ? -max : previous.lo,
+                            current.hi > previous.hi ? max : previous.hi);
+}
+
+const ResolvedExpr *getCondition(const ResolvedStmt *terminator) {
+  if (const auto *ifStmt = dynamic_cast<const ResolvedIfStmt *>(terminator))
+    return ifStmt->condition.get();
+
+  if (const auto *whileStmt =
+          dynamic_cast<const ResolvedWhileStmt *>(terminator))
+    return whileStmt->condition.get();
+
+  return nullptr;
+}
+
+// The variable the expression reads, if it's nothing else.
+const ResolvedVarDecl *getVariable(const ResolvedExpr &expr) {
+  if (const auto *grouping = dynamic_cast<const ResolvedGroupingExpr *>(&expr))
+    return getVariable(*grouping->expr);
+
+  if (const auto *dre = dynamic_cast<const ResolvedDeclRefExpr *>(&expr))
+    return dynamic_cast<const ResolvedVarDecl *>(dre->decl);
+
+  return nullptr;
+}
+} // namespace
+
+Range IntegerRangeAnalysis::Range::getIntegral(int64_t lo, int64_t hi) {
+  if (lo < -maxExactInteger || hi > maxExactInteger)
+    return getOverdefined();
+
+  return {Kind::Integral, lo, hi};
+}
+
+Range IntegerRangeAnalysis::Range::getValue(double value) {
+  // NaN, the infinities and the fractions are not integers.
+  if (value != std::trunc(value) || std::abs(value) > maxExactInteger ||
+      (value == 0.0 && std::signbit(value)))
+    return getOverdefined();
+
+  return getIntegral(static_cast<int64_t>(value), static_cast<int64_t>(value));
+}
+
+bool IntegerRangeAnalysis::Range::operator==(const Range &other) const {
+  if (kind != other.kind)
+    return false;
+
+  return kind != Kind::Integral || (lo == other.lo && hi == other.hi);
+}
+
+IntegerRangeAnalysis::IntegerRangeAnalysis(const CFG &cfg)
+    : cfg(&cfg),
+      variables(cfg) {}
+
+Range IntegerRangeAnalysis::evaluateBinaryOperator(
+    const ResolvedBinaryOperator &binop, const Environment &env) {
+  Range lhs = evaluate(*binop.lhs, env);
+  Range rhs = evaluate(*binop.rhs, env);
+
+  if (lhs.kind == Range::Kind::Undefined || rhs.kind == Range::Kind::Undefined)
+    return Range();
+
+  // Comparisons and logical operators result in 0 or 1, even if the operands
+  // are NaN.
+  if (binop.op == TokenKind::Lt || binop.op == TokenKind::Gt ||
+      binop.op == TokenKind::EqualEqual || binop.op == TokenKind::AmpAmp ||
+      binop.op == TokenKind::PipePipe)
+    return Range::getIntegral(0, 1);
+
+  if (!lhs.isIntegral() || !rhs.isIntegral())
+    return Range::getOverdefined();
+
+  // The bounds are at most 2^53, so they can be added without overflowing.
+  if (binop.op == TokenKind::Plus)
+    return Range::getIntegral(lhs.lo + rhs.lo, lhs.hi + rhs.hi);
+
+  if (binop.op == TokenKind::Minus)
+    return Range::getIntegral(lhs.lo - rhs.hi, lhs.hi - rhs.lo);
+
+  if (binop.op == TokenKind::Asterisk) {
+    // Zero multiplied by a negative number is -0.
+    auto containsZero = [](const Range &r) { return r.lo <= 0 && 0 <= r.hi; };
+    if ((containsZero(lhs) && rhs.lo < 0) || (containsZero(rhs) && lhs.lo < 0))
+      return Range::getOverdefined();
+
+    int64_t products[4];
+    if (llvm::MulOverflow(lhs.lo, rhs.lo, products[0]) ||
+        llvm::MulOverflow(lhs.lo, rhs.hi, products[1]) ||
+        llvm::MulOverflow(lhs.hi, rhs.lo, products[2]) ||
+        llvm::MulOverflow(lhs.hi, rhs.hi, products[3]))
+      return Range::getOverdefined();
+
+    return Range::getIntegral(*std::min_element(products, products + 4),
+                              *std::max_element(products, products + 4));
+  }
+
+  // Quotients are rarely integers.
+  return Range::getOverdefined();
+}
+
+Range IntegerRangeAnalysis::evaluateUnaryOperator(
+    const ResolvedUnaryOperator &unop, const Environment &env) {
+  Range operand = evaluate(*unop.operand, env);
+  if (operand.kind == Range::Kind::Undefined)
+    return operand;
+
+  if (unop.op == TokenKind::Excl)
+    return Range::getIntegral(0, 1);
+
+  // Negating zero results in -0.
+  if (!operand.isIntegral() || (operand.lo <= 0 && 0 <= operand.hi))
+    return Range::getOverdefined();
+
+  return Range::getIntegral(-operand.hi, -operand.lo);
+}
+
+Range IntegerRangeAnalysis::evaluate(const ResolvedExpr &expr,
+                                     const Environment &env) {
+  // The results of calls are not known.
+  Range range = Range::getOverdefined();
+
+  if (std::optional<double> val = expr.getConstantValue())
+    range = Range::getValue(*val);
+  else if (const auto *numberLiteral =
+               dynamic_cast<const ResolvedNumberLiteral *>(&expr))
+    range = Range::getValue(numberLiteral->value);
+  else if (const auto *dre = dynamic_cast<const ResolvedDeclRefExpr *>(&expr)) {
+    // The parameters can hold any number.
+    if (const auto *var = dynamic_cast<const ResolvedVarDecl *>(dre->decl))
+      range = env[variables.getIndex(var)];
+  } else if (const auto *groupingExpr =
+                 dynamic_cast<const ResolvedGroupingExpr *>(&expr))
+    range = evaluate(*groupingExpr->expr, env);
+  else if (const auto *binop =
+               dynamic_cast<const ResolvedBinaryOperator *>(&expr))
+    range = evaluateBinaryOperator(*binop, env);
+  else if (const auto *unop =
+               dynamic_cast<const ResolvedUnaryOperator *>(&expr))
+    range = evaluateUnaryOperator(*unop, env);
+
+  if (record)
+    expressions[&expr] = meet(expressions.lookup(&expr), range);
+
+  return range;
+}
+
+bool IntegerRangeAnalysis::refineComparison(
+    const ResolvedBinaryOperator &binop, bool taken, Environment &env) {
+  if (binop.op != TokenKind::Lt && binop.op != TokenKind::Gt &&
+      binop.op != TokenKind::EqualEqual)
+    return true;
+
+  // 'a > b' is handled as 'b < a'.
+  const ResolvedExpr *lhsExpr = binop.lhs.get();
+  const ResolvedExpr *rhsExpr = binop.rhs.get();
+  if (binop.op == TokenKind::Gt)
+    std::swap(lhsExpr, rhsExpr);
+
+  Range lhs = evaluate(*lhsExpr, env);
+  Range rhs = evaluate(*rhsExpr, env);
+  if (!lhs.isIntegral() || !rhs.isIntegral())
+    return true;
+
+  if (binop.op == TokenKind::EqualEqual) {
+    if (taken) {
+      lhs.lo = rhs.lo = std::max(lhs.lo, rhs.lo);
+      lhs.hi = rhs.hi = std::min(lhs.hi, rhs.hi);
+    } else if (lhs.lo == lhs.hi && lhs == rhs) {
+      return false;
+    }
+  } else if (taken) {
+    lhs.hi = std::min(lhs.hi, rhs.hi - 1);
+    rhs.lo = std::max(rhs.lo, lhs.lo + 1);
+  } else {
+    lhs.lo = std::max(lhs.lo, rhs.lo);
+    rhs.hi = std::min(rhs.hi, lhs.hi);
+  }
+
+  if (lhs.lo > lhs.hi || rhs.lo > rhs.hi)
+    return false;
+
+  if (const ResolvedVarDecl *var = getVariable(*lhsExpr))
+    env[variables.getIndex(var)] = lhs;
+
+  if (const ResolvedVarDecl *var = getVariable(*rhsExpr))
+    env[variables.getIndex(var)] = rhs;
+
+  return true;
+}
+
+bool IntegerRangeAnalysis::refine(const ResolvedExpr &condition,
+                                  bool taken,
+                                  Environment &env) {
+  if (std::optional<double> val = condition.getConstantValue())
+    return toBool(*val) == taken;
+
+  if (const auto *grouping =
+          dynamic_cast<const ResolvedGroupingExpr *>(&condition))
+    return refine(*grouping->expr, taken, env);
+
+  if (const auto *unop =
+          dynamic_cast<const ResolvedUnaryOperator *>(&condition))
+    return unop->op != TokenKind::Excl || refine(*unop->operand, !taken, env);
+
+  const auto *binop = dynamic_cast<const ResolvedBinaryOperator *>(&condition);
+  if (!binop)
+    return true;
+
+  // Both operands of && are true if the branch is taken, and both operands
+  // of || are false if it isn't. Otherwise either of them can decide it.
+  if (binop->op == TokenKind::AmpAmp || binop->op == TokenKind::PipePipe) {
+    if (taken == (binop->op == TokenKind::PipePipe))
+      return true;
+
+    return refine(*binop->lhs, taken, env) && refine(*binop->rhs, taken, env);
+  }
+
+  return refineComparison(*binop, taken, env);
+}
+
+void IntegerRangeAnalysis::transfer(int block, Environment &env) {
+  auto define = [&](const ResolvedVarDecl *var, Range range) {
+    env[variables.getIndex(var)] = range;
+    if (record)
+      definitions[var] = meet(definitions.lookup(var), range);
+  };
+
+  for (auto &&stmt : cfg->getStatements(block)) {
+    if (const auto *decl = dynamic_cast<const ResolvedDeclStmt *>(stmt)) {
+      const ResolvedVarDecl *var = decl->varDecl.get();
+
+      if (var->initializer)
+        define(var, evaluate(*var->initializer, env));
+      else
+        env[variables.getIndex(var)] = Range();
+      continue;
+    }
+
+    if (const auto *assignment =
+            dynamic_cast<const ResolvedAssignment *>(stmt)) {
+      const auto *var =
+          dynamic_cast<const ResolvedVarDecl *>(assignment->variable->decl);
+      define(var, evaluate(*assignment->expr, env));
+      continue;
+    }
+
+    if (const auto *call = dynamic_cast<const ResolvedCallExpr *>(stmt)) {
+      for (auto &&arg : call->arguments)
+        evaluate(*arg, env);
+      continue;
+    }
+
+    if (const auto *returnStmt =
+            dynamic_cast<const ResolvedReturnStmt *>(stmt)) {
+      if (returnStmt->expr)
+        evaluate(*returnStmt->expr, env);
+      continue;
+    }
+
+    if (const ResolvedExpr *condition = getCondition(stmt))
+      evaluate(*condition, env);
+  }
+}
+
+void IntegerRangeAnalysis::run() {
+  int blockCount = cfg->getBlockCount();
+
+  std::vector<int> order = getReversePostOrder(*cfg);
+  std::vector<int> position(order.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    position[order[i]] = i;
+
+  // The target of an edge that doesn't go forward in reverse post-order is
+  // the header of a loop.
+  std::vector<bool> isLoopHeader(blockCount);
+  for (int bb = 0; bb < blockCount; ++bb)
+    for (auto &&[pred, reachable] : cfg->getPredecessors(bb))
+      isLoopHeader[bb] = isLoopHeader[bb] || position[pred] >= position[bb];
+
+  in.assign(blockCount, Environment(variables.size()));
+  out.assign(blockCount, Environment(variables.size()));
+  llvm::BitVector executed(blockCount);
+
+  // Joins the outputs of the executed predecessors, narrowed by the
+  // conditions of the edges. Returns false if the block is not reached.
+  auto join = [&](int bb, Environment &env) {
+    if (bb == cfg->entry)
+      return true;
+
+    bool reached = false;
+    llvm::SmallVector<int, 4> visited;
+    for (auto &&[pred, reachable] : cfg->getPredecessors(bb)) {
+      if (!executed[pred] || llvm::is_contained(visited, pred))
+        continue;
+      visited.emplace_back(pred);
+
+      llvm::ArrayRef<CFGEdge> succs = cfg->getSuccessors(pred);
+      llvm::ArrayRef<const ResolvedStmt *> stmts = cfg->getStatements(pred);
+      const ResolvedExpr *condition =
+          succs.size() == 2 && !stmts.empty() ? getCondition(stmts.back())
+                                              : nullptr;
+
+      for (size_t i = 0; i < succs.size(); ++i) {
+        if (succs[i].block != bb || !succs[i].reachable)
+          continue;
+
+        Environment edge = out[pred];
+        if (condition && !refine(*condition, i == 0, edge))
+          continue;
+
+        for (size_t v = 0; v < env.size(); ++v)
+          env[v] = meet(env[v], edge[v]);
+        reached = true;
+      }
+    }
+
+    return reached;
+  };
+
+  auto sweep = [&](bool widening) {
+    bool changed = false;
+
+    for (int bb : order) {
+      Environment env(variables.size());
+      if (!join(bb, env))
+        continue;
+
+      if (widening && isLoopHeader[bb] && executed[bb])
+        for (size_t v = 0; v < env.size(); ++v)
+          env[v] = widen(in[bb][v], env[v]);
+
+      if (executed[bb] && env == in[bb])
+        continue;
+
+      executed.set(bb);
+      in[bb] = env;
+      transfer(bb, env);
+      out[bb] = std::move(env);
+      changed = true;
+    }
+
+    return changed;
+  };
+
+  while (sweep(/*widening=*/true))
+    ;
+
+  for (unsigned i = 0; i < narrowingSweeps; ++i)
+    if (!sweep(/*widening=*/false))
+      break;
+
+  // Every executed block is evaluated once more with its final input to
+  // record the ranges.
+  record = true;
+  for (int bb = 0; bb < blockCount; ++bb) {
+    if (!executed[bb])
+      continue;
+
+    Environment env = in[bb];
+    transfer(bb, env);
+  }
+  record = false;
+}
+
+bool IntegerRangeAnalysis::isIntegral(const ResolvedExpr &expr) const {
+  auto it = expressions.find(&expr);
+  return it != expressions.end() && it->second.isIntegral();
+}
+
+bool IntegerRangeAnalysis::isIntegral(const ResolvedDecl &decl) const {
+  const auto *var = dynamic_cast<const ResolvedVarDecl *>(&decl);
+  if (!var)
+    return false;
+
+  auto it = definitions.find(var);
+  return it != definitions.end() && it->second.isIntegral();
+}
+} // namespace yl
@@ -0,0 +1,280 @@
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/bit.h>
+
+#include <cstdint>
+
+#include "constexpr.h"
+#include "sccp.h"
+
+namespace yl {
+namespace {
+using Value = ConstantPropagation::Value;
+
+Value meet(const Value &lhs, const Value &rhs) {
+  if (lhs.kind == Value::Kind::Undefined)
+    return rhs;
+
+  if (rhs.kind == Value::Kind::Undefined || lhs == rhs)
+    return lhs;
+
+  return Value::getOverdefined();
+}
+
+const ResolvedExpr *getCondition(const ResolvedStmt *terminator) {
+  if (const auto *ifStmt = dynamic_cast<const ResolvedIfStmt *>(terminator))
+    return ifStmt->condition.get();
+
+  if (const auto *whileStmt =
+          dynamic_cast<const ResolvedWhileStmt *>(terminator))
+    return whileStmt->condition.get();
+
+  return nullptr;
+}
+
+// The CFG only holds const pointers, but the tree is owned by Sema, which
+// runs the analysis on it.
+void fold(const ResolvedExpr &expr, const Value &val) {
+  if (val.isConstant() && !expr.getConstantValue())
+    const_cast<ResolvedExpr &>(expr).setConstantValue(val.constant);
+}
+} // namespace
+
+bool ConstantPropagation::Value::operator==(const Value &other) const {
+  if (kind != other.kind)
+    return false;
+
+  // Compare the bits to tell 0 and -0 apart and to treat NaN as equal to
+  // itself.
+  return kind != Kind::Constant || llvm::bit_cast<uint64_t>(constant) ==
+                                       llvm::bit_cast<uint64_t>(other.constant);
+}
+
+ConstantPropagation::ConstantPropagation(CFG &cfg)
+    : cfg(&cfg),
+      variables(cfg) {}
+
+Value ConstantPropagation::evaluateBinaryOperator(
+    const ResolvedBinaryOperator &binop,
+    const Environment &env,
+    bool allowSideEffects) {
+  Value lhs = evaluate(*binop.lhs, env, allowSideEffects);
+
+  if (binop.op == TokenKind::PipePipe || binop.op == TokenKind::AmpAmp) {
+    bool isOr = binop.op == TokenKind::PipePipe;
+
+    // The same rules as in ConstantExpressionEvaluator, if a side of the
+    // operator decides the result, the other one doesn't matter.
+    if (lhs.kind == Value::Kind::Undefined)
+      return lhs;
+
+    if (lhs.isConstant() && toBool(lhs.constant) == isOr)
+      return Value::getConstant(isOr);
+
+    if (!lhs.isConstant() && !allowSideEffects)
+      return lhs;
+
+    Value rhs = evaluate(*binop.rhs, env, allowSideEffects);
+    if (rhs.isConstant() && toBool(rhs.constant) == isOr)
+      return Value::getConstant(isOr);
+
+    if (lhs.isConstant() && rhs.isConstant())
+      return Value::getConstant(toBool(rhs.constant));
+
+    return rhs.kind == Value::Kind::Undefined ? rhs : Value::getOverdefined();
+  }
+
+  Value rhs = evaluate(*binop.rhs, env, allowSideEffects);
+  if (lhs.kind == Value::Kind::Overdefined ||
+      rhs.kind == Value::Kind::Overdefined)
+    return Value::getOverdefined();
+
+  if (!lhs.isConstant() || !rhs.isConstant())
+    return Value();
+
+  return Value::getConstant(
+      applyBinaryOperator(binop.op, lhs.constant, rhs.constant));
+}
+
+Value ConstantPropagation::evaluate(const ResolvedExpr &expr,
+                                    const Environment &env,
+                                    bool allowSideEffects) {
+  if (std::optional<double> val = expr.getConstantValue())
+    return Value::getConstant(*val);
+
+  if (const auto *numberLiteral =
+          dynamic_cast<const ResolvedNumberLiteral *>(&expr))
+    return Value::getConstant(numberLiteral->value);
+
+  if (const auto *dre = dynamic_cast<const ResolvedDeclRefExpr *>(&expr)) {
+    if (const auto *var = dynamic_cast<const ResolvedVarDecl *>(dre->decl))
+      return env[variables.getIndex(var)];
+
+    return Value::getOverdefined();
+  }
+
+  if (const auto *groupingExpr =
+          dynamic_cast<const ResolvedGroupingExpr *>(&expr))
+    return evaluate(*groupingExpr->expr, env, allowSideEffects);
+
+  if (const auto *binop = dynamic_cast<const ResolvedBinaryOperator *>(&expr))
+    return evaluateBinaryOperator(*binop, env, allowSideEffects);
+
+  if (const auto *unop = dynamic_cast<const ResolvedUnaryOperator *>(&expr)) {
+    Value operand = evaluate(*unop->operand, env, allowSideEffects);
+    if (!operand.isConstant())
+      return operand;
+
+    if (unop->op == TokenKind::Excl)
+      return Value::getConstant(!toBool(operand.constant));
+
+    if (unop->op == TokenKind::Minus)
+      return Value::getConstant(-operand.constant);
+
+    llvm_unreachable("unexpected unary operator");
+  }
+
+  // The result of a call is only known if it has already been folded.
+  return Value::getOverdefined();
+}
+
+void ConstantPropagation::transfer(int block, Environment &env, bool fold) {
+  auto evaluateSlot = [&](const ResolvedExpr &expr) {
+    Value val = evaluate(expr, env, false);
+    if (fold)
+      yl::fold(expr, val);
+    return val;
+  };
+
+  for (auto &&stmt : cfg->getStatements(block)) {
+    if (const auto *decl = dynamic_cast<const ResolvedDeclStmt *>(stmt)) {
+      const ResolvedVarDecl *var = decl->varDecl.get();
+
+      Value val;
+      if (var->initializer)
+        val = evaluateSlot(*var->initializer);
+
+      env[variables.getIndex(var)] = val;
+      continue;
+    }
+
+    if (const auto *assignment =
+            dynamic_cast<const ResolvedAssignment *>(stmt)) {
+      const auto *var =
+          dynamic_cast<const ResolvedVarDecl *>(assignment->variable->decl);
+      env[variables.getIndex(var)] = evaluateSlot(*assignment->expr);
+      continue;
+    }
+
+    if (const auto *call = dynamic_cast<const ResolvedCallExpr *>(stmt)) {
+      for (auto &&arg : call->arguments)
+        evaluateSlot(*arg);
+      continue;
+    }
+
+    if (const auto *returnStmt =
+            dynamic_cast<const ResolvedReturnStmt *>(stmt)) {
+      if (returnStmt->expr)
+        evaluateSlot(*returnStmt->expr);
+      continue;
+    }
+
+    if (const ResolvedExpr *condition = getCondition(stmt))
+      evaluateSlot(*condition);
+  }
+}
+
+void ConstantPropagation::run() {
+  int blockCount = cfg->getBlockCount();
+
+  std::vector<int> order = getReversePostOrder(*cfg);
+  std::vector<int> position(order.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    position[order[i]] = i;
+
+  in.assign(blockCount, Environment(variables.size()));
+  out.assign(blockCount, Environment(variables.size()));
+
+  executableEdges.clear();
+  for (int bb = 0; bb < blockCount; ++bb)
+    executableEdges.emplace_back(cfg->getSuccessors(bb).size(), false);
+
+  auto isExecutable = [&](int from, int to) {
+    llvm::ArrayRef<CFGEdge> succs = cfg->getSuccessors(from);
+    for (size_t i = 0; i < succs.size(); ++i)
+      if (succs[i].block == to && executableEdges[from][i])
+        return true;
+    return false;
+  };
+
+  // The blocks are swept in reverse post-order, starting with only the entry
+  // pending. A block becomes pending once an edge to it is executable or the
+  // output of an executable predecessor changes.
+  llvm::BitVector pending(order.size());
+  llvm::BitVector executedBlocks(blockCount);
+  pending.set(position[cfg->entry]);
+
+  for (int pos = pending.find_first(); pos != -1;) {
+    pending.reset(pos);
+    int bb = order[pos];
+    executedBlocks.set(bb);
+
+    Environment env(variables.size());
+    for (auto &&[pred, reachable] : cfg->getPredecessors(bb)) {
+      if (!isExecutable(pred, bb))
+        continue;
+
+      for (size_t i = 0; i < env.size(); ++i)
+        env[i] = meet(env[i], out[pred][i]);
+    }
+
+    in[bb] = env;
+    transfer(bb, env, false);
+
+    bool changed = env != out[bb];
+    out[bb] = std::move(env);
+
+    // The edges that the CFG builder already proved unreachable are never
+    // executed. An undefined condition reads an uninitialized variable, which
+    // is reported separately, so both of its edges are kept.
+    llvm::ArrayRef<CFGEdge> succs = cfg->getSuccessors(bb);
+    const ResolvedStmt *terminator = cfg->getStatements(bb).empty()
+                                         ? nullptr
+                                         : cfg->getStatements(bb).back();
+    const ResolvedExpr *condition = getCondition(terminator);
+    Value conditionValue = Value::getOverdefined();
+    if (condition && succs.size() == 2)
+      conditionValue = evaluate(*condition, out[bb], true);
+
+    for (size_t i = 0; i < succs.size(); ++i) {
+      if (!succs[i].reachable)
+        continue;
+
+      if (conditionValue.isConstant() &&
+          toBool(conditionValue.constant) != (i == 0))
+        continue;
+
+      if (executableEdges[bb][i] && !changed)
+        continue;
+
+      executableEdges[bb][i] = true;
+      pending.set(position[succs[i].block]);
+    }
+
+    int next = pending.find_next(pos);
+    pos = next != -1 ? next : pending.find_first();
+  }
+
+  for (int bb = 0; bb < blockCount; ++bb) {
+    // Only the blocks that can be executed are folded.
+    if (executedBlocks[bb]) {
+      Environment env = in[bb];
+      transfer(bb, env, true);
+    }
+
+    llvm::ArrayRef<CFGEdge> succs = cfg->getSuccessors(bb);
+    for (size_t i = 0; i < succs.size(); ++i)
+      if (succs[i].reachable && !executableEdges[bb][i])
+        cfg->markUnreachable(bb, i);
+  }
+}
+} // namespace yl
@@ -1,19 +1,105 @@
+#include <llvm/ADT/SmallPtrSet.h>
+
 #include <cassert>
-#include <map>
-#include <set>
+#include <iostream>
 
+#include "callgraph.h"
 #include "cfg.h"
+#include "dataflow.h"
+#include "liveness.h"
+#include "sccp.h"
 #include "sema.h"
 #include "utils.h"
 
 namespace yl {
+void Sema::foldConstantCalls(ResolvedBlock &block,
+                             ConstantExpressionEvaluator &callEvaluator) {
+  for (auto &&stmt : block.statements) {
+    // The value of an expression statement is not used, only its calls are
+    // folded.
+    if (auto *expr = dynamic_cast<ResolvedExpr *>(stmt.get())) {
+      foldConstantCalls(*expr, callEvaluator, true);
+      continue;
+    }
+
+    if (auto *ifStmt = dynamic_cast<ResolvedIfStmt *>(stmt.get())) {
+      foldConstantCalls(*ifStmt->condition, callEvaluator);
+      foldConstantCalls(*ifStmt->trueBlock, callEvaluator);
+      if (ifStmt->falseBlock)
+        foldConstantCalls(*ifStmt->falseBlock, callEvaluator);
+      continue;
+    }
+
+    if (auto *whileStmt = dynamic_cast<ResolvedWhileStmt *>(stmt.get())) {
+      foldConstantCalls(*whileStmt->condition, callEvaluator);
+      foldConstantCalls(*whileStmt->body, callEvaluator);
+      continue;
+    }
+
+    if (auto *declStmt = dynamic_cast<ResolvedDeclStmt *>(stmt.get())) {
+      if (auto &init = declStmt->varDecl->initializer)
+        foldConstantCalls(*init, callEvaluator);
+      continue;
+    }
+
+    if (auto *assignment = dynamic_cast<ResolvedAssignment *>(stmt.get())) {
+      foldConstantCalls(*assignment->expr, callEvaluator);
+      continue;
+    }
+
+    if (auto *returnStmt = dynamic_cast<ResolvedReturnStmt *>(stmt.get())) {
+      if (returnStmt->expr)
+        foldConstantCalls(*returnStmt->expr, callEvaluator);
+      continue;
+    }
+  }
+}
+
+void Sema::foldConstantCalls(ResolvedExpr &expr,
+                             ConstantExpressionEvaluator &callEvaluator,
+                             bool isOperand) {
+  if (expr.getConstantValue())
+    return;
+
+  // Operands of other expressions only receive a value if they are calls, the
+  // same way as they don't receive one during resolution.
+  auto *call = dynamic_cast<ResolvedCallExpr *>(&expr);
+  if (!isOperand || call) {
+    expr.setConstantValue(callEvaluator.evaluate(expr, false));
+    if (expr.getConstantValue())
+      return;
+  }
+
+  if (call) {
+    for (auto &&arg : call->arguments)
+      foldConstantCalls(*arg, callEvaluator);
+    return;
+  }
+
+  if (auto *grouping = dynamic_cast<ResolvedGroupingExpr *>(&expr))
+    return foldConstantCalls(*grouping->expr, callEvaluator, true);
+
+  if (auto *binop = dynamic_cast<ResolvedBinaryOperator *>(&expr)) {
+    foldConstantCalls(*binop->lhs, callEvaluator, true);
+    foldConstantCalls(*binop->rhs, callEvaluator, true);
+    return;
+  }
+
+  if (auto *unop = dynamic_cast<ResolvedUnaryOperator *>(&expr))
+    return foldConstantCalls(*unop->operand, callEvaluator, true);
+}
+
 bool Sema::runFlowSensitiveChecks(const ResolvedFunctionDecl &fn) {
-  CFG cfg = CFGBuilder().build(fn);
+  CFG cfg = CFGBuilder(cee).build(fn);
+  ConstantPropagation(cfg).run();
 
   bool error = false;
   error |= checkReturnOnAllPaths(fn, cfg);
   error |= checkVariableInitialization(cfg);
 
+  if (!error && warnUnusedValues)
+    checkUnusedValues(cfg);
+
   return error;
 };
 
@@ -22,34 +108,27 @@ bool Sema::checkReturnOnAllPaths(const ResolvedFunctionDecl &fn,
   if (fn.type.kind == Type::Kind::Void)
     return false;
 
-  int returnCount = 0;
-  bool exitReached = false;
-
-  std::set<int> visited;
-  std::vector<int> worklist;
-  worklist.emplace_back(cfg.entry);
-
-  while (!worklist.empty()) {
-    int bb = worklist.back();
-    worklist.pop_back();
-
-    if (!visited.emplace(bb).second)
-      continue;
-
-    exitReached |= bb == cfg.exit;
-
-    const auto &[preds, succs, stmts] = cfg.basicBlocks[bb];
+  auto isReturnBlock = [&](int bb) {
+    llvm::ArrayRef<const ResolvedStmt *> stmts = cfg.getStatements(bb);
+    return !stmts.empty() &&
+           dynamic_cast<const ResolvedReturnStmt *>(stmts.back());
+  };
 
-    if (!stmts.empty() && dynamic_cast<const ResolvedReturnStmt *>(stmts[0])) {
-      ++returnCount;
-      continue;
-    }
+  // A single bit tracking whether the block can be reached from the entry
+  // without passing through a return statement.
+  BitVectorDataflow reachability(cfg, BitVectorDataflow::Direction::Forward, 1,
+                                 /*onlyReachableEdges=*/true);
+  reachability.setBoundaryState(llvm::BitVector(1, true));
+  reachability.solve([&](int bb, llvm::BitVector &state) {
+    if (isReturnBlock(bb))
+      state.reset();
+  });
 
-    for (auto &&[succ, reachable] : succs)
-      if (reachable)
-        worklist.emplace_back(succ);
-  }
+  int returnCount = 0;
+  for (int bb = 0; bb < cfg.getBlockCount(); ++bb)
+    returnCount += isReturnBlock(bb) && reachability.getIn(bb).test(0);
 
+  bool exitReached = reachability.getIn(cfg.exit).test(0);
   if (exitReached || returnCount == 0) {
     report(fn.location,
            returnCount > 0
@@ -61,81 +140,75 @@ bool Sema::checkReturnOnAllPaths(const ResolvedFunctionDecl &fn,
 }
 
 bool Sema::checkVariableInitialization(const CFG &cfg) {
-  enum class State { Bottom, Unassigned, Assigned, Top };
-
-  using Lattice = std::map<const ResolvedVarDecl *, State>;
-
-  auto joinStates = [](State s1, State s2) {
-    if (s1 == s2)
-      return s1;
+  // Every variable is tracked by 2 bits, one for the possibility of being
+  // unassigned and one for being assigned. The empty set is the bottom of
+  // the lattice, while having both bits set is the top.
+  VariableNumbering variables(cfg);
 
-    if (s1 == State::Bottom)
-      return s2;
-
-    if (s2 == State::Bottom)
-      return s1;
-
-    return State::Top;
+  auto unassigned = [&](const ResolvedVarDecl *var) {
+    return 2 * variables.getIndex(var);
+  };
+  auto assigned = [&](const ResolvedVarDecl *var) {
+    return 2 * variables.getIndex(var) + 1;
+  };
+  auto isExactly = [&](const llvm::BitVector &state, unsigned bit) {
+    unsigned other = bit ^ 1;
+    return state.test(bit) && !state.test(other);
   };
 
-  std::vector<Lattice> curLattices(cfg.basicBlocks.size());
   std::vector<std::pair<SourceLocation, std::string>> pendingErrors;
 
-  bool changed = true;
-  while (changed) {
-    changed = false;
-    pendingErrors.clear();
-
-    for (int bb = cfg.entry; bb != cfg.exit; --bb) {
-      const auto &[preds, succs, stmts] = cfg.basicBlocks[bb];
-
-      Lattice tmp;
-      for (auto &&pred : preds)
-        for (auto &&[decl, state] : curLattices[pred.first])
-          tmp[decl] = joinStates(tmp[decl], state);
-
-      for (auto it = stmts.rbegin(); it != stmts.rend(); ++it) {
-        const ResolvedStmt *stmt = *it;
-
-        if (auto *decl = dynamic_cast<const ResolvedDeclStmt *>(stmt)) {
-          tmp[decl->varDecl.get()] =
-              decl->varDecl->initializer ? State::Assigned : State::Unassigned;
-          continue;
-        }
-
-        if (auto *assignment = dynamic_cast<const ResolvedAssignment *>(stmt)) {
-          const auto *var =
-              dynamic_cast<const ResolvedVarDecl *>(assignment->variable->decl);
+  auto transfer = [&](int bb, llvm::BitVector &state, bool collectErrors) {
+    for (auto &&stmt : cfg.getStatements(bb)) {
+      if (auto *decl = dynamic_cast<const ResolvedDeclStmt *>(stmt)) {
+        const ResolvedVarDecl *var = decl->varDecl.get();
+        state.reset(unassigned(var));
+        state.reset(assigned(var));
+        state.set(var->initializer ? assigned(var) : unassigned(var));
+        continue;
+      }
 
-          assert(var &&
-                 "assignment to non-variables should have been caught by sema");
+      if (auto *assignment = dynamic_cast<const ResolvedAssignment *>(stmt)) {
+        const auto *var =
+            dynamic_cast<const ResolvedVarDecl *>(assignment->variable->decl);
 
-          if (!var->isMutable && tmp[var] != State::Unassigned) {
-            std::string msg = '\'' + var->identifier + "' cannot be mutated";
-            pendingErrors.emplace_back(assignment->location, std::move(msg));
-          }
+        assert(var &&
+               "assignment to non-variables should have been caught by sema");
 
-          tmp[var] = State::Assigned;
-          continue;
+        if (collectErrors && !var->isMutable &&
+            !isExactly(state, unassigned(var))) {
+          std::string msg = '\'' + var->identifier + "' cannot be mutated";
+          pendingErrors.emplace_back(assignment->location, std::move(msg));
         }
 
-        if (const auto *dre = dynamic_cast<const ResolvedDeclRefExpr *>(stmt)) {
-          const auto *var = dynamic_cast<const ResolvedVarDecl *>(dre->decl);
+        state.reset(unassigned(var));
+        state.set(assigned(var));
+        continue;
+      }
 
-          if (var && tmp[var] != State::Assigned) {
-            std::string msg = '\'' + var->identifier + "' is not initialized";
-            pendingErrors.emplace_back(dre->location, std::move(msg));
-          }
+      if (const auto *dre = dynamic_cast<const ResolvedDeclRefExpr *>(stmt)) {
+        const auto *var = dynamic_cast<const ResolvedVarDecl *>(dre->decl);
 
-          continue;
+        if (collectErrors && var && !isExactly(state, assigned(var))) {
+          std::string msg = '\'' + var->identifier + "' is not initialized";
+          pendingErrors.emplace_back(dre->location, std::move(msg));
         }
-      }
 
-      if (curLattices[bb] != tmp) {
-        curLattices[bb] = tmp;
-        changed = true;
+        continue;
       }
     }
+  };
+
+  BitVectorDataflow initialization(
+      cfg, BitVectorDataflow::Direction::Forward, 2 * variables.size());
+  initialization.solve([&](int bb, llvm::BitVector &state) {
+    transfer(bb, state, false);
+  });
+
+  // The errors are only collected once the fixpoint has been reached.
+  for (int bb = cfg.entry; bb != cfg.exit; --bb) {
+    llvm::BitVector state = initialization.getIn(bb);
+    transfer(bb, state, true);
   }
 
   for (auto &&[loc, msg] : pendingErrors)
@@ -144,6 +217,26 @@ bool Sema::checkVariableInitialization(const CFG &cfg) {
   return !pendingErrors.empty();
 }
 
+void Sema::checkUnusedValues(const CFG &cfg) {
+  // Every read counts, even the ones that were folded into a constant.
+  for (const ResolvedStmt *store :
+       findDeadStores(cfg, [](const ResolvedDeclRefExpr &) { return true; })) {
+    if (const auto *assignment =
+            dynamic_cast<const ResolvedAssignment *>(store)) {
+      report(assignment->location,
+             "value assigned to '" + assignment->variable->decl->identifier +
+                 "' is never read",
+             true);
+      continue;
+    }
+
+    const ResolvedVarDecl &var =
+        *static_cast<const ResolvedDeclStmt *>(store)->varDecl;
+    report(var.location,
+           "initial value of '" + var.identifier + "' is never read", true);
+  }
+}
+
 bool Sema::insertDeclToCurrentScope(ResolvedDecl &decl) {
   const auto &[foundDecl, scopeIdx] = lookupDecl(decl.identifier);
 
@@ -185,9 +278,33 @@ std::unique_ptr<ResolvedFunctionDecl> Sema::createBuiltinPrintln() {
       loc, std::vector<std::unique_ptr<ResolvedStmt>>());
 
   return std::make_unique<ResolvedFunctionDecl>(
-      loc, "println", Type::builtinVoid(), std::move(params), std::move(block));
+      loc, "println", Type::builtinVoid(), std::move(params), std::move(block),
+      FPMode::Default);
 };
 
+std::unique_ptr<ResolvedFunctionDecl>
+Sema::createBuiltinExpect(std::string identifier) {
+  SourceLocation loc{"<builtin>", 0, 0};
+
+  auto param =
+      std::make_unique<ResolvedParamDecl>(loc, "n", Type::builtinNumber());
+
+  // The argument is returned unchanged, the code generator only uses the call
+  // as a hint for the branches on it.
+  std::vector<std::unique_ptr<ResolvedStmt>> stmts;
+  stmts.emplace_back(std::make_unique<ResolvedReturnStmt>(
+      loc, std::make_unique<ResolvedDeclRefExpr>(loc, *param)));
+
+  std::vector<std::unique_ptr<ResolvedParamDecl>> params;
+  params.emplace_back(std::move(param));
+
+  auto block = std::make_unique<ResolvedBlock>(loc, std::move(stmts));
+
+  return std::make_unique<ResolvedFunctionDecl>(
+      loc, std::move(identifier), Type::builtinNumber(), std::move(params),
+      std::move(block), FPMode::Default);
+}
+
 std::optional<Type> Sema::resolveType(Type parsedType) {
   if (parsedType.kind == Type::Kind::Custom)
     return std::nullopt;
@@ -542,16 +659,35 @@ Sema::resolveFunctionDeclaration(const FunctionDecl &function) {
 
   return std::make_unique<ResolvedFunctionDecl>(
       function.location, function.identifier, *type, std::move(resolvedParams),
-      nullptr);
+      nullptr, function.fpMode);
 };
 
+bool Sema::resolveFunctionBody(ResolvedFunctionDecl &fn, const Block &body) {
+  currentFunction = &fn;
+
+  ScopeRAII paramScope(this);
+  for (auto &&param : fn.params)
+    insertDeclToCurrentScope(*param);
+
+  auto resolvedBody = resolveBlock(body);
+  if (!resolvedBody)
+    return true;
+
+  fn.body = std::move(resolvedBody);
+  return false;
+}
+
 std::vector<std::unique_ptr<ResolvedFunctionDecl>> Sema::resolveAST() {
   std::vector<std::unique_ptr<ResolvedFunctionDecl>> resolvedTree;
   auto println = createBuiltinPrintln();
 
-  // Insert println first to be able to detect a possible redeclaration.
+  // Insert the builtins first to be able to detect a possible redeclaration.
   ScopeRAII globalScope(this);
   insertDeclToCurrentScope(*resolvedTree.emplace_back(std::move(println)));
+  for (auto &&identifier : {"likely", "unlikely"})
+    insertDeclToCurrentScope(
+        *resolvedTree.emplace_back(createBuiltinExpect(identifier)));
+  size_t builtinCount = resolvedTree.size();
 
   bool error = false;
   for (auto &&fn : ast) {
@@ -569,26 +705,91 @@ std::vector<std::unique_ptr<ResolvedFunctionDecl>> Sema::resolveAST() {
   if (error)
     return {};
 
-  for (size_t i = 1; i < resolvedTree.size(); ++i) {
-    currentFunction = resolvedTree[i].get();
+  // The bodies only refer to the global scope, which doesn't change anymore,
+  // so they are resolved in parallel. The diagnostics of each function are
+  // buffered and emitted in source order to keep the output deterministic.
+  struct BodyResolution {
+    bool error = false;
+    std::string diagnostics;
+  };
 
-    ScopeRAII paramScope(this);
-    for (auto &&param : currentFunction->params)
-      insertDeclToCurrentScope(*param);
+  unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::unique_ptr<Sema>> workers(threadCount);
+  std::vector<BodyResolution> bodies(ast.size());
 
-    auto resolvedBody = resolveBlock(*ast[i - 1]->body);
-    if (!resolvedBody) {
-      error = true;
-      continue;
+  parallelFor(threadCount, ast.size(), [&](unsigned thread, size_t idx) {
+    std::unique_ptr<Sema> &worker = workers[thread];
+    if (!worker) {
+      worker = std::unique_ptr<Sema>(new Sema(scopes.front()));
+      worker->warnUnusedValues = warnUnusedValues;
     }
 
-    currentFunction->body = std::move(resolvedBody);
-    error |= runFlowSensitiveChecks(*currentFunction);
+    DiagnosticBuffer buffer;
+    ResolvedFunctionDecl &fn = *resolvedTree[idx + builtinCount];
+    bodies[idx].error = worker->resolveFunctionBody(fn, *ast[idx]->body);
+    if (!bodies[idx].error && !checkOnlyReachable)
+      bodies[idx].error = worker->runFlowSensitiveChecks(fn);
+    bodies[idx].diagnostics = buffer.str();
+  });
+
+  for (auto &&body : bodies) {
+    std::cerr << body.diagnostics;
+    error |= body.error;
   }
 
   if (error)
     return {};
 
+  // The calls are only known once every body is resolved. The functions
+  // that 'main' can't reach are dropped without being checked.
+  if (checkOnlyReachable) {
+    const ResolvedFunctionDecl *main = nullptr;
+    for (auto &&fn : resolvedTree)
+      if (fn->identifier == "main")
+        main = fn.get();
+
+    std::vector<const ResolvedFunctionDecl *> reachable =
+        CallGraph(resolvedTree).getReachableFunctions(*main);
+    std::vector<BodyResolution> checks(reachable.size());
+
+    parallelFor(threadCount, reachable.size(), [&](unsigned thread,
+                                                   size_t idx) {
+      // The builtins are not checked.
+      if (isBuiltin(*reachable[idx]))
+        return;
+
+      std::unique_ptr<Sema> &worker = workers[thread];
+      if (!worker) {
+        worker = std::unique_ptr<Sema>(new Sema(scopes.front()));
+        worker->warnUnusedValues = warnUnusedValues;
+      }
+
+      DiagnosticBuffer buffer;
+      checks[idx].error = worker->runFlowSensitiveChecks(*reachable[idx]);
+      checks[idx].diagnostics = buffer.str();
+    });
+
+    for (auto &&check : checks) {
+      std::cerr << check.diagnostics;
+      error |= check.error;
+    }
+
+    if (error)
+      return {};
+
+    llvm::SmallPtrSet<const ResolvedFunctionDecl *, 16> isReachable(
+        reachable.begin(), reachable.end());
+    llvm::erase_if(resolvedTree, [&](auto &fn) {
+      return !isReachable.count(fn.get());
+    });
+  }
+
+  // Now that every body is resolved, the calls to pure functions can be
+  // executed at compile time.
+  ConstantExpressionEvaluator callEvaluator(/*evaluateCalls=*/true);
+  for (auto &&fn : resolvedTree)
+    foldConstantCalls(*fn->body, callEvaluator);
+
   return resolvedTree;
 }
 } // namespace yl
@@ -0,0 +1,172 @@
+#include <llvm/ADT/bit.h>
+
+#include <string>
+
+#include "cfg.h"
+#include "constexpr.h"
+#include "sccp.h"
+#include "specializer.h"
+
+namespace yl {
+namespace {
+// Stores the value of every outermost expression that is known at compile
+// time, the same way as the calls are folded after resolution.
+class ConstantFolder : public TreeWalker {
+  ConstantExpressionEvaluator *cee;
+
+  void visit(std::unique_ptr<ResolvedExpr> &expr) override {
+    expr->setConstantValue(cee->evaluate(*expr, false));
+    if (!expr->getConstantValue())
+      walkOperands(*expr);
+  }
+
+public:
+  explicit ConstantFolder(ConstantExpressionEvaluator &cee)
+      : cee(&cee) {}
+};
+
+// Replaces the branches with a constant condition with the block that is
+// taken and drops the statements after a return. The declarations are
+// referenced directly, so the statements of a block can be moved into its
+// parent.
+void removeDeadBranches(ResolvedBlock &block) {
+  std::vector<std::unique_ptr<ResolvedStmt>> statements;
+
+  for (auto &&stmt : block.statements) {
+    if (auto *ifStmt = dynamic_cast<ResolvedIfStmt *>(stmt.get())) {
+      if (std::optional<double> cond = ifStmt->condition->getConstantValue()) {
+        ResolvedBlock *taken = toBool(*cond) ? ifStmt->trueBlock.get()
+                                             : ifStmt->falseBlock.get();
+        if (!taken)
+          continue;
+
+        removeDeadBranches(*taken);
+        for (auto &&takenStmt : taken->statements)
+          statements.emplace_back(std::move(takenStmt));
+      } else {
+        removeDeadBranches(*ifStmt->trueBlock);
+        if (ifStmt->falseBlock)
+          removeDeadBranches(*ifStmt->falseBlock);
+        statements.emplace_back(std::move(stmt));
+      }
+    } else if (auto *whileStmt =
+                   dynamic_cast<ResolvedWhileStmt *>(stmt.get())) {
+      std::optional<double> cond = whileStmt->condition->getConstantValue();
+      if (cond && !toBool(*cond))
+        continue;
+
+      removeDeadBranches(*whileStmt->body);
+      statements.emplace_back(std::move(stmt));
+    } else {
+      statements.emplace_back(std::move(stmt));
+    }
+
+    if (!statements.empty() &&
+        dynamic_cast<const ResolvedReturnStmt *>(statements.back().get()))
+      break;
+  }
+
+  block.statements = std::move(statements);
+}
+} // namespace
+
+std::unique_ptr<ResolvedFunctionDecl>
+Specializer::specialize(const ResolvedFunctionDecl &fn,
+                        const std::vector<std::optional<uint64_t>> &args) {
+  TreeCloner cloner;
+
+  // Only the parameters whose argument is not known are kept.
+  std::vector<std::unique_ptr<ResolvedParamDecl>> params;
+  for (size_t i = 0; i < fn.params.size(); ++i) {
+    const ResolvedParamDecl &param = *fn.params[i];
+
+    if (args[i]) {
+      cloner.replaceWithConstant(param, llvm::bit_cast<double>(*args[i]));
+      continue;
+    }
+
+    auto &clonedParam =
+        params.emplace_back(std::make_unique<ResolvedParamDecl>(
+            param.location, param.identifier, param.type));
+    cloner.replace(param, *clonedParam);
+  }
+
+  auto clone = std::make_unique<ResolvedFunctionDecl>(
+      fn.location, fn.identifier, fn.type, std::move(params),
+      cloner.clone(*fn.body), fn.fpMode);
+
+  // The evaluator memoizes the results by the address of the expressions, so
+  // a new one is used for every copy.
+  ConstantExpressionEvaluator cee(callBudget);
+  ConstantFolder(cee).walk(*clone->body);
+
+  CFG cfg = CFGBuilder(cee).build(*clone);
+  ConstantPropagation(cfg).run();
+  removeDeadBranches(*clone->body);
+
+  return clone;
+}
+
+const ResolvedFunctionDecl *
+Specializer::getSpecialization(const ResolvedCallExpr &call) {
+  const ResolvedFunctionDecl &callee = *call.callee;
+
+  // The builtins have no body to specialize, and likely and unlikely must
+  // stay calls for codegen to recognize them.
+  if (isBuiltin(callee))
+    return nullptr;
+
+  SpecializationKey key{&callee, {}};
+  bool hasConstantArg = false;
+  for (auto &&arg : call.arguments) {
+    std::optional<double> val = arg->getConstantValue();
+    hasConstantArg |= val.has_value();
+    key.second.emplace_back(
+        val ? std::optional(llvm::bit_cast<uint64_t>(*val)) : std::nullopt);
+  }
+
+  if (!hasConstantArg)
+    return nullptr;
+
+  if (auto it = specializations.find(key); it != specializations.end())
+    return it->second;
+
+  const ResolvedFunctionDecl *specialization = nullptr;
+  auto clone = specialize(callee, key.second);
+
+  unsigned cloneSize = getSize(*clone->body);
+  if (cloneSize < getSize(*callee.body) && cloneSize <= budget) {
+    budget -= cloneSize;
+    clone->identifier += ".specialized." +
+                         std::to_string(++specializationCounts[&callee]);
+    specialization = resolvedTree->emplace_back(std::move(clone)).get();
+  }
+
+  specializations.emplace(std::move(key), specialization);
+  return specialization;
+}
+
+void Specializer::visit(std::unique_ptr<ResolvedExpr> &expr) {
+  walkOperands(*expr);
+
+  auto *call = dynamic_cast<ResolvedCallExpr *>(expr.get());
+  if (!call)
+    return;
+
+  const ResolvedFunctionDecl *specialization = getSpecialization(*call);
+  if (!specialization)
+    return;
+
+  // The constant arguments have no side effects, so they can be dropped.
+  llvm::erase_if(call->arguments,
+                 [](auto &arg) { return arg->getConstantValue(); });
+  call->callee = specialization;
+}
+
+void Specializer::run() {
+  // The copies are appended to the tree, so the calls in them are
+  // specialized too.
+  for (size_t i = 0; i < resolvedTree->size(); ++i)
+    walk(*(*resolvedTree)[i]->body);
+}
+} // namespace yl
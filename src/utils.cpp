@@ -4,14 +4,26 @@
 #include "utils.h"
 
 namespace yl {
+namespace {
+thread_local std::ostream *diagnosticStream = &std::cerr;
+} // namespace
+
 std::nullptr_t
 report(SourceLocation location, std::string_view message, bool isWarning) {
   const auto &[file, line, col] = location;
 
   assert(!file.empty() && line != 0 && col != 0);
-  std::cerr << file << ':' << line << ':' << col << ':'
-            << (isWarning ? " warning: " : " error: ") << message << '\n';
+  *diagnosticStream << file << ':' << line << ':' << col << ':'
+                    << (isWarning ? " warning: " : " error: ") << message
+                    << '\n';
 
   return nullptr;
 }
+
+DiagnosticBuffer::DiagnosticBuffer()
+    : previous(diagnosticStream) {
+  diagnosticStream = &buffer;
+}
+
+DiagnosticBuffer::~DiagnosticBuffer() { diagnosticStream = previous; }
 } // namespace yl
@@ -5,3 +5,5 @@ config.name = "how-to-compile-your-language"
 config.test_format = lit.formats.ShTest(False if os.name == 'nt' else True)
 
 config.suffixes = ['.yl']
+
+config.excludes = ['Inputs']